@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 tex_coord;
+
+uniform sampler2D density;
+
+out vec4 frag_color;
+
+void main() {
+    vec4 cell = texture(density, tex_coord);
+    if (cell.a == 0.0)
+        discard;
+
+    // The color is premultiplied by the share of the cell the particles cover, which is what a pixel that
+    // covers the whole cell would show over the black background
+    frag_color = vec4(cell.rgb, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+layout (location = 0) in vec3 v_pos;
+
+uniform vec4 grid_scale;
+uniform mat4 _MProj;
+
+out vec2 tex_coord;
+
+void main() {
+    vec2 grid_size = grid_scale.xy / 2.;
+    vec2 cell_size = grid_scale.zw;
+
+    gl_Position = _MProj * vec4(v_pos.xy * grid_size * cell_size, 0.0, 1.0);
+
+    // The first row of the texture is the top row of cells
+    tex_coord = vec2(v_pos.x + 1.0, 1.0 - v_pos.y) * 0.5;
+}
@@ -0,0 +1,9 @@
+#version 330 core
+
+layout (location = 0) in vec2 v_pos;
+
+uniform mat4 _MProj;
+
+void main() {
+    gl_Position = _MProj * vec4(v_pos, 0.0, 1.0);
+}
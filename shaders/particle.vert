@@ -1,8 +1,9 @@
 #version 330 core
 
 layout (location = 0) in vec3 v_pos;
-layout (location = 1) in vec4 position_and_radius;
+layout (location = 1) in vec2 position;
 layout (location = 2) in vec4 color;
+layout (location = 3) in float radius;
 
 uniform mat4 _MProj;
 
@@ -10,13 +11,12 @@ out vec2 frag_pos;
 out vec4 circle_color;
 
 void main() {
-    vec3 pos = position_and_radius.xyz;
-    float scale = position_and_radius.w;
+    float scale = radius;
     mat4 transform = mat4(
-        vec4(scale, 0.0,   0.0,   0.0),
-        vec4(0.0,   scale, 0.0,   0.0),
-        vec4(0.0,   0.0,   scale, 0.0),
-        vec4(pos.x, pos.y, pos.z, 1.0)
+        vec4(scale,      0.0,        0.0,   0.0),
+        vec4(0.0,        scale,      0.0,   0.0),
+        vec4(0.0,        0.0,        scale, 0.0),
+        vec4(position.x, position.y, 0.0,   1.0)
     );
 
     gl_Position = _MProj * transform * vec4(v_pos, 1.0);
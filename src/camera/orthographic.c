@@ -1,24 +1,62 @@
 #include "orthographic.h"
 
-OrthoCamera ortho_camera_new(int width, int height) {
-    float half_width = (float)width / 2.0;
-    float half_height = (float)height / 2.0;
+static void ortho_camera_update_projection(OrthoCamera *camera) {
+    cm2_vec2 min, max;
+    ortho_camera_view_rect(camera, &min, &max);
 
-    OrthoCamera camera;
-    cm2_mat4_create_orthographic(camera.projection_matrix,
-            -half_width, half_width,
-            -half_height, half_height,
+    cm2_mat4_create_orthographic(camera->projection_matrix,
+            min.x, max.x,
+            min.y, max.y,
             -100.0, 100.0);
+}
 
+OrthoCamera ortho_camera_new(int width, int height) {
+    OrthoCamera camera;
+    camera.center = cm2_vec2_new(0.0, 0.0);
+    camera.zoom = 1.0;
+    camera.width = width;
+    camera.height = height;
+    ortho_camera_update_projection(&camera);
     return camera;
 }
 
 void ortho_camera_on_window_resize(OrthoCamera *camera, int width, int height) {
-    float half_width = (float)width / 2.0;
-    float half_height = (float)height / 2.0;
+    camera->width = width;
+    camera->height = height;
+    ortho_camera_update_projection(camera);
+}
 
-    cm2_mat4_create_orthographic(camera->projection_matrix,
-            -half_width, half_width,
-            -half_height, half_height,
-            -100.0, 100.0);
+cm2_vec2 ortho_camera_screen_to_world(OrthoCamera *camera, double screen_x, double screen_y) {
+    return cm2_vec2_new(
+        camera->center.x + ((float)screen_x - camera->width / 2.0) / camera->zoom,
+        camera->center.y + (camera->height / 2.0 - (float)screen_y) / camera->zoom
+    );
+}
+
+void ortho_camera_pan(OrthoCamera *camera, double delta_x, double delta_y) {
+    // Screen y points down, world y points up
+    camera->center.x -= (float)delta_x / camera->zoom;
+    camera->center.y += (float)delta_y / camera->zoom;
+    ortho_camera_update_projection(camera);
+}
+
+void ortho_camera_zoom_at(OrthoCamera *camera, float factor, double screen_x, double screen_y) {
+    cm2_vec2 anchor = ortho_camera_screen_to_world(camera, screen_x, screen_y);
+
+    float zoom = camera->zoom * factor;
+    if (zoom < ORTHO_CAMERA_MIN_ZOOM) zoom = ORTHO_CAMERA_MIN_ZOOM;
+    if (zoom > ORTHO_CAMERA_MAX_ZOOM) zoom = ORTHO_CAMERA_MAX_ZOOM;
+    camera->zoom = zoom;
+
+    // Move the center so that the anchor ends up under the same screen position again
+    camera->center.x = anchor.x - ((float)screen_x - camera->width / 2.0) / zoom;
+    camera->center.y = anchor.y - (camera->height / 2.0 - (float)screen_y) / zoom;
+    ortho_camera_update_projection(camera);
+}
+
+void ortho_camera_view_rect(OrthoCamera *camera, cm2_vec2 *min, cm2_vec2 *max) {
+    float half_width = (float)camera->width / 2.0 / camera->zoom;
+    float half_height = (float)camera->height / 2.0 / camera->zoom;
+    *min = cm2_vec2_new(camera->center.x - half_width, camera->center.y - half_height);
+    *max = cm2_vec2_new(camera->center.x + half_width, camera->center.y + half_height);
 }
@@ -3,11 +3,36 @@
 
 #include "../../thirdparty/../thirdparty/c_math2d.h"
 
+// Factor the zoom changes by per scroll step
+#ifndef ORTHO_CAMERA_ZOOM_STEP
+#define ORTHO_CAMERA_ZOOM_STEP 1.1
+#endif /* ORTHO_CAMERA_ZOOM_STEP */
+
+#ifndef ORTHO_CAMERA_MIN_ZOOM
+#define ORTHO_CAMERA_MIN_ZOOM 0.05
+#endif /* ORTHO_CAMERA_MIN_ZOOM */
+
+#ifndef ORTHO_CAMERA_MAX_ZOOM
+#define ORTHO_CAMERA_MAX_ZOOM 20.0
+#endif /* ORTHO_CAMERA_MAX_ZOOM */
+
+// Camera looking at `center`, with `zoom` pixels per world unit. Screen coordinates are in pixels,
+// starting at the top left corner of the window.
 typedef struct {
     cm2_mat4 projection_matrix;
+    cm2_vec2 center;
+    float zoom;
+    int width, height;
 } OrthoCamera;
 
 OrthoCamera ortho_camera_new(int width, int height);
 void ortho_camera_on_window_resize(OrthoCamera *camera, int width, int height);
+cm2_vec2 ortho_camera_screen_to_world(OrthoCamera *camera, double screen_x, double screen_y);
+// Moves the camera so that the world follows the cursor moving by (`delta_x`, `delta_y`) pixels
+void ortho_camera_pan(OrthoCamera *camera, double delta_x, double delta_y);
+// Zooms by `factor`, keeping the world position under the given screen position in place
+void ortho_camera_zoom_at(OrthoCamera *camera, float factor, double screen_x, double screen_y);
+// Corners of the visible part of the world
+void ortho_camera_view_rect(OrthoCamera *camera, cm2_vec2 *min, cm2_vec2 *max);
 
 #endif /* CAMERA_ORTHOGRAPHIC_H */
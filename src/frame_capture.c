@@ -0,0 +1,248 @@
+#include "frame_capture.h"
+
+#include "opengl/render_state.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../thirdparty/c_log.h"
+
+FrameCapture frame_capture_new(FrameCaptureFormat format) {
+    FrameCapture frame_capture = {0};
+    frame_capture.format = format;
+    for (size_t i = 0; i < FRAME_CAPTURE_BUFFER_COUNT; ++i) {
+        frame_capture.buffers[i] = buffer_new(GL_PIXEL_PACK_BUFFER);
+    }
+    return frame_capture;
+}
+
+static void frame_capture_write_frame(FrameCapture *frame_capture, CapturedFrame *frame) {
+    char path[256];
+    if (frame_capture->format == FRAME_CAPTURE_FORMAT_PPM) {
+        snprintf(path, sizeof(path), "%s/frame_%06lu.ppm", FRAME_CAPTURE_DEFAULT_DIRECTORY, frame->index);
+    } else {
+        snprintf(path, sizeof(path), "%s/frame_%06lu_%dx%d.rgba", FRAME_CAPTURE_DEFAULT_DIRECTORY,
+                 frame->index, frame->width, frame->height);
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        c_log(C_LOG_SEVERITY_ERROR, "Can't write captured frame '%s'", path);
+        return;
+    }
+
+    // Rows are written from the top of the frame, GL stores them from the bottom
+    size_t row_size = (size_t) frame->width * 4;
+    if (frame_capture->format == FRAME_CAPTURE_FORMAT_PPM) {
+        fprintf(file, "P6\n%d %d\n255\n", frame->width, frame->height);
+
+        uint8_t *row = (uint8_t *) malloc((size_t) frame->width * 3);
+        for (int y = frame->height - 1; y >= 0; --y) {
+            uint8_t *pixels = frame->pixels + y * row_size;
+            for (int x = 0; x < frame->width; ++x) {
+                row[x * 3 + 0] = pixels[x * 4 + 0];
+                row[x * 3 + 1] = pixels[x * 4 + 1];
+                row[x * 3 + 2] = pixels[x * 4 + 2];
+            }
+            fwrite(row, 3, frame->width, file);
+        }
+        free(row);
+    } else {
+        for (int y = frame->height - 1; y >= 0; --y) {
+            fwrite(frame->pixels + y * row_size, 1, row_size, file);
+        }
+    }
+
+    if (fclose(file) != 0) {
+        c_log(C_LOG_SEVERITY_ERROR, "Can't write captured frame '%s'", path);
+    }
+}
+
+static void *frame_capture_run(void *data) {
+    FrameCapture *frame_capture = data;
+
+    // Writing has to give way to the simulation and the render thread, capture can drop frames instead.
+    // On Linux, the nice value of a thread only applies to that thread.
+    if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), FRAME_CAPTURE_WRITER_NICE) != 0) {
+        c_log(C_LOG_SEVERITY_WARNING, "Can't lower the priority of the frame capture thread");
+    }
+
+    pthread_mutex_lock(&frame_capture->mutex);
+    for (;;) {
+        while (frame_capture->queue_len == 0 && frame_capture->running) {
+            pthread_cond_wait(&frame_capture->queue_changed, &frame_capture->mutex);
+        }
+
+        // Only stop once all queued frames are written
+        if (frame_capture->queue_len == 0) {
+            break;
+        }
+
+        CapturedFrame *frame = &frame_capture->queue[frame_capture->queue_start];
+        pthread_mutex_unlock(&frame_capture->mutex);
+
+        frame_capture_write_frame(frame_capture, frame);
+
+        pthread_mutex_lock(&frame_capture->mutex);
+        frame_capture->queue_start = (frame_capture->queue_start + 1) % FRAME_CAPTURE_MAX_QUEUED_FRAMES;
+        frame_capture->queue_len--;
+        frame_capture->written_count++;
+    }
+    pthread_mutex_unlock(&frame_capture->mutex);
+
+    return NULL;
+}
+
+bool frame_capture_start(FrameCapture *frame_capture) {
+    if (mkdir(FRAME_CAPTURE_DEFAULT_DIRECTORY, 0755) != 0 && errno != EEXIST) {
+        c_log(C_LOG_SEVERITY_ERROR, "Can't create capture directory '%s'", FRAME_CAPTURE_DEFAULT_DIRECTORY);
+        return false;
+    }
+
+    pthread_mutex_init(&frame_capture->mutex, NULL);
+    pthread_cond_init(&frame_capture->queue_changed, NULL);
+    frame_capture->running = true;
+    if (pthread_create(&frame_capture->thread, NULL, frame_capture_run, frame_capture) != 0) {
+        c_log(C_LOG_SEVERITY_ERROR, "Failed to create frame capture thread");
+        exit(EXIT_FAILURE);
+    }
+
+    c_log(C_LOG_SEVERITY_INFO, "Capturing frames to '%s'", FRAME_CAPTURE_DEFAULT_DIRECTORY);
+    return true;
+}
+
+// Copies the frame that was read into the buffer out of it and queues it for the writer thread
+static void frame_capture_collect(FrameCapture *frame_capture, size_t buffer_idx) {
+    GLsync fence = frame_capture->fences[buffer_idx];
+    if (!fence) {
+        return;
+    }
+    frame_capture->fences[buffer_idx] = NULL;
+
+    // Only the writer thread takes frames out of the queue, so if there is space now, there still is
+    // when the frame is queued, and the slot after the end of the queue isn't touched by the writer
+    pthread_mutex_lock(&frame_capture->mutex);
+    bool queue_full = frame_capture->queue_len >= FRAME_CAPTURE_MAX_QUEUED_FRAMES;
+    size_t queue_idx = (frame_capture->queue_start + frame_capture->queue_len) % FRAME_CAPTURE_MAX_QUEUED_FRAMES;
+    pthread_mutex_unlock(&frame_capture->mutex);
+    if (queue_full) {
+        glDeleteSync(fence);
+        render_state_count_calls(1);
+        frame_capture->dropped_count++;
+        return;
+    }
+
+    // The read was issued a few frames ago, so it's usually done already
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;) {
+        GLenum result = glClientWaitSync(fence, flags, FRAME_CAPTURE_FENCE_TIMEOUT);
+        render_state_count_calls(1);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+            break;
+        }
+        flags = 0;
+    }
+    glDeleteSync(fence);
+
+    CapturedFrame *frame = &frame_capture->queue[queue_idx];
+    size_t size = frame_capture->buffer_sizes[buffer_idx];
+    if (frame->pixels_cap < size) {
+        free(frame->pixels);
+        frame->pixels = (uint8_t *) malloc(size);
+        frame->pixels_cap = size;
+    }
+    frame->width = frame_capture->frame_widths[buffer_idx];
+    frame->height = frame_capture->frame_heights[buffer_idx];
+    frame->index = frame_capture->frame_indices[buffer_idx];
+
+    buffer_bind(&frame_capture->buffers[buffer_idx]);
+    void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data) {
+        memcpy(frame->pixels, data, size);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    render_state_count_calls(3);
+
+    if (!data) {
+        frame_capture->dropped_count++;
+        return;
+    }
+
+    pthread_mutex_lock(&frame_capture->mutex);
+    frame_capture->queue_len++;
+    pthread_cond_signal(&frame_capture->queue_changed);
+    pthread_mutex_unlock(&frame_capture->mutex);
+}
+
+void frame_capture_frame(FrameCapture *frame_capture, int width, int height) {
+    if (!frame_capture->running || width <= 0 || height <= 0) {
+        return;
+    }
+
+    // Take the last frame out of the buffer before reading the new one into it
+    size_t buffer_idx = frame_capture->next_buffer;
+    frame_capture_collect(frame_capture, buffer_idx);
+
+    Buffer *buffer = &frame_capture->buffers[buffer_idx];
+    size_t size = (size_t) width * height * 4;
+    buffer_bind(buffer);
+    if (frame_capture->buffer_sizes[buffer_idx] != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        render_state_count_calls(1);
+        frame_capture->buffer_sizes[buffer_idx] = size;
+    }
+
+    // With a pixel pack buffer bound, the read only queues a copy on the GPU and returns immediately
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    frame_capture->fences[buffer_idx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    render_state_count_calls(2);
+
+    frame_capture->frame_widths[buffer_idx] = width;
+    frame_capture->frame_heights[buffer_idx] = height;
+    frame_capture->frame_indices[buffer_idx] = frame_capture->frame_count;
+    frame_capture->frame_count++;
+    frame_capture->next_buffer = (buffer_idx + 1) % FRAME_CAPTURE_BUFFER_COUNT;
+
+    // Other reads of pixels go to client memory again
+    render_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void frame_capture_stop(FrameCapture *frame_capture) {
+    if (!frame_capture->running) {
+        return;
+    }
+
+    // Collect the outstanding reads, oldest first
+    for (size_t i = 0; i < FRAME_CAPTURE_BUFFER_COUNT; ++i) {
+        frame_capture_collect(frame_capture, (frame_capture->next_buffer + i) % FRAME_CAPTURE_BUFFER_COUNT);
+    }
+    render_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pthread_mutex_lock(&frame_capture->mutex);
+    frame_capture->running = false;
+    pthread_cond_signal(&frame_capture->queue_changed);
+    pthread_mutex_unlock(&frame_capture->mutex);
+
+    pthread_join(frame_capture->thread, NULL);
+    pthread_cond_destroy(&frame_capture->queue_changed);
+    pthread_mutex_destroy(&frame_capture->mutex);
+
+    c_log(C_LOG_SEVERITY_INFO, "Captured %lu frames (%lu dropped)",
+          frame_capture->written_count, frame_capture->dropped_count);
+}
+
+void frame_capture_delete(FrameCapture *frame_capture) {
+    for (size_t i = 0; i < FRAME_CAPTURE_BUFFER_COUNT; ++i) {
+        buffer_delete(&frame_capture->buffers[i]);
+    }
+
+    for (size_t i = 0; i < FRAME_CAPTURE_MAX_QUEUED_FRAMES; ++i) {
+        free(frame_capture->queue[i].pixels);
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "opengl/buffer.h"
+
+#include <GL/glew.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of pixel buffers that frames are read into. A frame is only copied out of its buffer when the
+// buffer is needed again, so the GPU has this many frames of time to finish the read.
+#ifndef FRAME_CAPTURE_BUFFER_COUNT
+#define FRAME_CAPTURE_BUFFER_COUNT 3
+#endif /* FRAME_CAPTURE_BUFFER_COUNT */
+
+// Longest queue of frames that wait for the writer thread. If the disk can't keep up, new frames are
+// dropped instead of stalling the render thread.
+#ifndef FRAME_CAPTURE_MAX_QUEUED_FRAMES
+#define FRAME_CAPTURE_MAX_QUEUED_FRAMES 8
+#endif /* FRAME_CAPTURE_MAX_QUEUED_FRAMES */
+
+// Nice value of the writer thread, so it only takes CPU time that the simulation and rendering don't need
+#ifndef FRAME_CAPTURE_WRITER_NICE
+#define FRAME_CAPTURE_WRITER_NICE 10
+#endif /* FRAME_CAPTURE_WRITER_NICE */
+
+// Directory (relative to the working directory) that the frames are written to
+#ifndef FRAME_CAPTURE_DEFAULT_DIRECTORY
+#define FRAME_CAPTURE_DEFAULT_DIRECTORY "capture"
+#endif /* FRAME_CAPTURE_DEFAULT_DIRECTORY */
+
+// Longest time (in nanoseconds) that is waited for a read to finish before waiting is retried
+#ifndef FRAME_CAPTURE_FENCE_TIMEOUT
+#define FRAME_CAPTURE_FENCE_TIMEOUT 1000000
+#endif /* FRAME_CAPTURE_FENCE_TIMEOUT */
+
+typedef enum {
+    // Binary PPM (P6) with RGB pixels
+    FRAME_CAPTURE_FORMAT_PPM,
+    // RGBA pixels without a header, the size of each frame is part of its file name
+    FRAME_CAPTURE_FORMAT_RAW
+} FrameCaptureFormat;
+
+// Frame that was copied out of a pixel buffer, waiting to be written. The rows are in the order of GL,
+// starting at the bottom of the frame. The pixel memory belongs to the queue slot and is reused by later
+// frames, since allocating several megabytes for every frame costs more than copying them.
+typedef struct {
+    uint8_t *pixels;
+    size_t pixels_cap;
+    int width, height;
+    size_t index;
+} CapturedFrame;
+
+// Records the frames of the window as an image sequence. The render thread only issues reads of the
+// framebuffer into a ring of pixel buffer objects, and copies each frame out of its buffer a few frames
+// later, when the GPU is done with it. The frames are then handed to a writer thread, which converts and
+// writes them to disk, so the render thread never waits for a read or for the disk.
+typedef struct {
+    FrameCaptureFormat format;
+
+    Buffer buffers[FRAME_CAPTURE_BUFFER_COUNT];
+    size_t buffer_sizes[FRAME_CAPTURE_BUFFER_COUNT];
+    // Fence, size and index of the frame that was read into each buffer, the fence is NULL if there is none
+    GLsync fences[FRAME_CAPTURE_BUFFER_COUNT];
+    int frame_widths[FRAME_CAPTURE_BUFFER_COUNT], frame_heights[FRAME_CAPTURE_BUFFER_COUNT];
+    size_t frame_indices[FRAME_CAPTURE_BUFFER_COUNT];
+    size_t next_buffer;
+
+    size_t frame_count;
+    size_t dropped_count;
+
+    // Guards the queue, the written count and the running flag. The frame at the start of the queue stays
+    // in it while it's written, so the render thread never fills a slot that is still being written.
+    pthread_mutex_t mutex;
+    pthread_cond_t queue_changed;
+    CapturedFrame queue[FRAME_CAPTURE_MAX_QUEUED_FRAMES];
+    size_t queue_start, queue_len;
+    size_t written_count;
+    bool running;
+    pthread_t thread;
+} FrameCapture;
+
+FrameCapture frame_capture_new(FrameCaptureFormat format);
+// Starts the writer thread. The thread refers to `frame_capture`, so it can't be moved until capturing stops.
+// Returns false if the capture directory can't be created.
+bool frame_capture_start(FrameCapture *frame_capture);
+// Reads the current framebuffer of the given size, call after drawing and before swapping the buffers
+void frame_capture_frame(FrameCapture *frame_capture, int width, int height);
+// Waits for the outstanding reads, writes all queued frames and stops the writer thread
+void frame_capture_stop(FrameCapture *frame_capture);
+void frame_capture_delete(FrameCapture *frame_capture);
+
+#endif /* FRAME_CAPTURE_H */
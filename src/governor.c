@@ -0,0 +1,290 @@
+#include "governor.h"
+
+#include "util/math.h"
+
+#include "../thirdparty/c_log.h"
+
+static const char *FRAME_GOVERNOR_PHASE_NAMES[FRAME_GOVERNOR_PHASE_COUNT] = {
+    "simulation",
+    "snapshot"
+};
+
+static size_t frame_governor_get_sub_step_limit(FrameGovernor *governor) {
+    Solver *solver = &governor->updater->solver;
+    return solver->adaptive_sub_steps ? solver->max_sub_steps : solver->sub_steps;
+}
+
+static void frame_governor_set_sub_step_limit(FrameGovernor *governor, size_t sub_steps) {
+    Solver *solver = &governor->updater->solver;
+    if (!solver->adaptive_sub_steps) {
+        solver->sub_steps = sub_steps;
+        return;
+    }
+
+    // The adaptive range can't be narrower than its lower bound
+    if (sub_steps < solver->min_sub_steps) sub_steps = solver->min_sub_steps;
+    solver->max_sub_steps = sub_steps;
+    if (solver->sub_steps > sub_steps) solver->sub_steps = sub_steps;
+}
+
+FrameGovernor frame_governor_new(ParticleUpdater *updater, float target_frame_time) {
+    FrameGovernor governor;
+    governor.updater = updater;
+    governor.target_frame_time = target_frame_time;
+    governor.high_watermark = FRAME_GOVERNOR_DEFAULT_HIGH_WATERMARK;
+    governor.low_watermark = FRAME_GOVERNOR_DEFAULT_LOW_WATERMARK;
+    governor.decision_interval = FRAME_GOVERNOR_DEFAULT_DECISION_INTERVAL;
+
+    for (size_t i = 0; i < FRAME_GOVERNOR_PHASE_COUNT; ++i) {
+        governor.phase_times[i] = 0.0;
+    }
+    governor.simulation_steps = 0;
+    governor.simulation_sub_steps = 0;
+    governor.frames = 0;
+    clock_gettime(CLOCK_MONOTONIC, &governor.phase_start);
+
+    governor.base_sub_steps = frame_governor_get_sub_step_limit(&governor);
+    governor.min_sub_steps = FRAME_GOVERNOR_DEFAULT_MIN_SUB_STEPS;
+
+    governor.base_spawn_time_interval = updater->particle_spawn_time_interval;
+    governor.max_spawn_slowdown = FRAME_GOVERNOR_DEFAULT_MAX_SPAWN_SLOWDOWN;
+    governor.exhausted = false;
+
+    governor.section_count = NULL;
+    governor.max_section_count = 0;
+    governor.thread_direction = 1;
+    governor.threads_settled = true;
+    governor.threads_settled_particles = 0;
+    governor.thread_probe.pending = false;
+    governor.thread_probe.previous_section_count = 0;
+    governor.thread_probe.previous_cost = 0.0;
+    return governor;
+}
+
+void frame_governor_control_threads(FrameGovernor *governor, size_t *section_count, size_t max_section_count) {
+    governor->section_count = section_count;
+    governor->max_section_count = max_section_count;
+    governor->threads_settled = false;
+}
+
+void frame_governor_begin_phase(FrameGovernor *governor) {
+    clock_gettime(CLOCK_MONOTONIC, &governor->phase_start);
+}
+
+void frame_governor_end_phase(FrameGovernor *governor, FrameGovernorPhase phase) {
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    governor->phase_times[phase] += time_diff_ms(governor->phase_start, current_time);
+
+    if (phase == FRAME_GOVERNOR_PHASE_SIMULATION) {
+        ParticleUpdater *updater = governor->updater;
+        governor->simulation_steps += updater->last_advance_steps;
+        governor->simulation_sub_steps += updater->last_advance_steps * updater->solver.stats.sub_steps;
+    }
+}
+
+// Tries the next thread count in the current search direction, returns false if there's none left to try
+static bool frame_governor_probe_threads(FrameGovernor *governor, float sub_step_cost) {
+    size_t current = *governor->section_count;
+
+    for (size_t attempt = 0; attempt < 2; ++attempt) {
+        bool can_move = governor->thread_direction > 0
+            ? current < governor->max_section_count
+            : current > 1;
+
+        if (can_move) {
+            size_t next = governor->thread_direction > 0 ? current + 1 : current - 1;
+            governor->thread_probe.pending = true;
+            governor->thread_probe.previous_section_count = current;
+            governor->thread_probe.previous_cost = sub_step_cost;
+            *governor->section_count = next;
+            c_log(C_LOG_SEVERITY_INFO, "Governor: trying %lu instead of %lu threads", next, current);
+            return true;
+        }
+
+        governor->thread_direction = -governor->thread_direction;
+    }
+
+    return false;
+}
+
+static void frame_governor_settle_threads(FrameGovernor *governor) {
+    governor->threads_settled = true;
+    governor->threads_settled_particles = governor->updater->particle_list.buffer_len;
+    c_log(C_LOG_SEVERITY_INFO, "Governor: settled on %lu threads", *governor->section_count);
+}
+
+// Judges the thread count that was probed since the last decision
+static void frame_governor_evaluate_thread_probe(FrameGovernor *governor, float sub_step_cost) {
+    FrameGovernorThreadProbe *probe = &governor->thread_probe;
+    probe->pending = false;
+
+    // Require a clear improvement, timings are noisy
+    if (sub_step_cost < probe->previous_cost * 0.95) {
+        c_log(C_LOG_SEVERITY_INFO, "Governor: keeping %lu threads (%.4f -> %.4f us per particle and sub step)",
+              *governor->section_count, probe->previous_cost * 1000.0, sub_step_cost * 1000.0);
+        return;
+    }
+
+    c_log(C_LOG_SEVERITY_INFO, "Governor: reverting to %lu threads (%.4f -> %.4f us per particle and sub step)",
+          probe->previous_section_count, probe->previous_cost * 1000.0, sub_step_cost * 1000.0);
+    *governor->section_count = probe->previous_section_count;
+
+    // Searching in the other direction only makes sense if this one was the first to fail
+    if (governor->thread_direction > 0) {
+        governor->thread_direction = -1;
+    } else {
+        governor->thread_direction = 1;
+        frame_governor_settle_threads(governor);
+    }
+}
+
+static bool frame_governor_reduce_load(FrameGovernor *governor, float frame_time, float sub_step_time, float sub_step_cost) {
+    ParticleUpdater *updater = governor->updater;
+
+    // Finding a faster thread count doesn't cost any quality, so try that first
+    if (governor->section_count && !governor->threads_settled) {
+        if (frame_governor_probe_threads(governor, sub_step_cost)) {
+            return true;
+        }
+        frame_governor_settle_threads(governor);
+    }
+
+    // Drop as many sub steps as are needed to get below the budget, judging by what one sub step costs
+    size_t sub_steps = frame_governor_get_sub_step_limit(governor);
+    if (sub_steps > governor->min_sub_steps) {
+        float excess = frame_time - governor->target_frame_time * governor->high_watermark;
+        size_t drop = sub_step_time > 0.0 ? (size_t) ceilf(excess / sub_step_time) : 1;
+        if (drop < 1) drop = 1;
+        if (drop > sub_steps - governor->min_sub_steps) drop = sub_steps - governor->min_sub_steps;
+
+        frame_governor_set_sub_step_limit(governor, sub_steps - drop);
+        c_log(C_LOG_SEVERITY_INFO, "Governor: frame took %.2f ms (target %.2f ms), lowering sub steps %lu -> %lu",
+              frame_time, governor->target_frame_time, sub_steps, frame_governor_get_sub_step_limit(governor));
+        return true;
+    }
+
+    // Spawn fewer particles, so the load grows slower. Particles are spawned at most once per step,
+    // so intervals below the step interval all spawn at the same rate.
+    float spawn_time_interval = updater->particle_spawn_time_interval;
+    if (spawn_time_interval < updater->step_interval) spawn_time_interval = updater->step_interval;
+
+    float max_spawn_time_interval = governor->base_spawn_time_interval;
+    if (max_spawn_time_interval < updater->step_interval) max_spawn_time_interval = updater->step_interval;
+    max_spawn_time_interval *= governor->max_spawn_slowdown;
+
+    if (spawn_time_interval < max_spawn_time_interval) {
+        float interval = spawn_time_interval * 2.0;
+        if (interval > max_spawn_time_interval) interval = max_spawn_time_interval;
+
+        c_log(C_LOG_SEVERITY_INFO, "Governor: frame took %.2f ms (target %.2f ms), slowing spawning %.1f -> %.1f ms",
+              frame_time, governor->target_frame_time, updater->particle_spawn_time_interval, interval);
+        updater->particle_spawn_time_interval = interval;
+        return true;
+    }
+
+    // Only warn once, until something could be adjusted again
+    if (!governor->exhausted) {
+        c_log(C_LOG_SEVERITY_WARNING, "Governor: frame took %.2f ms (target %.2f ms), nothing left to adjust",
+              frame_time, governor->target_frame_time);
+        governor->exhausted = true;
+        return true;
+    }
+
+    return false;
+}
+
+static bool frame_governor_restore_quality(FrameGovernor *governor, float frame_time) {
+    ParticleUpdater *updater = governor->updater;
+
+    // Undo the steps of `frame_governor_reduce_load` in reverse order
+    if (updater->particle_spawn_time_interval > governor->base_spawn_time_interval) {
+        float interval = updater->particle_spawn_time_interval * 0.5;
+        if (interval < updater->step_interval || interval < governor->base_spawn_time_interval) {
+            interval = governor->base_spawn_time_interval;
+        }
+
+        c_log(C_LOG_SEVERITY_INFO, "Governor: frame took %.2f ms (target %.2f ms), speeding up spawning %.1f -> %.1f ms",
+              frame_time, governor->target_frame_time, updater->particle_spawn_time_interval, interval);
+        updater->particle_spawn_time_interval = interval;
+        governor->exhausted = false;
+        return true;
+    }
+
+    size_t sub_steps = frame_governor_get_sub_step_limit(governor);
+    if (sub_steps < governor->base_sub_steps) {
+        frame_governor_set_sub_step_limit(governor, sub_steps + 1);
+        c_log(C_LOG_SEVERITY_INFO, "Governor: frame took %.2f ms (target %.2f ms), raising sub steps %lu -> %lu",
+              frame_time, governor->target_frame_time, sub_steps, sub_steps + 1);
+        governor->exhausted = false;
+        return true;
+    }
+
+    return false;
+}
+
+static void frame_governor_decide(FrameGovernor *governor) {
+    ParticleUpdater *updater = governor->updater;
+    float frames = (float)governor->frames;
+
+    float frame_time = 0.0;
+    for (size_t i = 0; i < FRAME_GOVERNOR_PHASE_COUNT; ++i) {
+        frame_time += governor->phase_times[i] / frames;
+    }
+
+    // Cost of a single sub step, per frame and per particle. The latter doesn't change with the particle count,
+    // so it can be compared between decisions to judge thread counts.
+    float simulation_time = governor->phase_times[FRAME_GOVERNOR_PHASE_SIMULATION];
+    size_t particle_count = updater->particle_list.buffer_len;
+    float sub_step_time = 0.0;
+    float sub_step_cost = 0.0;
+    if (governor->simulation_sub_steps > 0) {
+        float steps_per_frame = (float)governor->simulation_steps / frames;
+        sub_step_time = simulation_time / (float)governor->simulation_sub_steps * steps_per_frame;
+        if (particle_count > 0) {
+            sub_step_cost = simulation_time / (float)governor->simulation_sub_steps / (float)particle_count;
+        }
+    }
+
+    // Look for a better thread count again once the load has changed a lot
+    if (governor->section_count && governor->threads_settled &&
+        particle_count > governor->threads_settled_particles + governor->threads_settled_particles / 2) {
+        governor->threads_settled = false;
+    }
+
+    bool decided = false;
+    if (governor->thread_probe.pending) {
+        frame_governor_evaluate_thread_probe(governor, sub_step_cost);
+        decided = true;
+    } else if (frame_time > governor->target_frame_time * governor->high_watermark) {
+        decided = frame_governor_reduce_load(governor, frame_time, sub_step_time, sub_step_cost);
+    } else if (frame_time < governor->target_frame_time * governor->low_watermark) {
+        decided = frame_governor_restore_quality(governor, frame_time);
+    }
+
+    // Show what the decision was based on
+    if (decided) {
+        c_log(C_LOG_SEVERITY_DEBUG, "Governor: %lu particles, %.2f ms per frame (%s %.2f, %s %.2f)",
+              particle_count, frame_time,
+              FRAME_GOVERNOR_PHASE_NAMES[FRAME_GOVERNOR_PHASE_SIMULATION],
+              governor->phase_times[FRAME_GOVERNOR_PHASE_SIMULATION] / frames,
+              FRAME_GOVERNOR_PHASE_NAMES[FRAME_GOVERNOR_PHASE_SNAPSHOT],
+              governor->phase_times[FRAME_GOVERNOR_PHASE_SNAPSHOT] / frames);
+    }
+}
+
+void frame_governor_end_frame(FrameGovernor *governor) {
+    governor->frames++;
+    if (governor->frames < governor->decision_interval) {
+        return;
+    }
+
+    frame_governor_decide(governor);
+
+    for (size_t i = 0; i < FRAME_GOVERNOR_PHASE_COUNT; ++i) {
+        governor->phase_times[i] = 0.0;
+    }
+    governor->simulation_steps = 0;
+    governor->simulation_sub_steps = 0;
+    governor->frames = 0;
+}
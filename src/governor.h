@@ -0,0 +1,91 @@
+#ifndef FRAME_GOVERNOR_H
+#define FRAME_GOVERNOR_H
+
+#include "updater.h"
+
+#include <stdbool.h>
+#include <time.h>
+
+// Number of frames that are averaged before the governor makes a decision
+#ifndef FRAME_GOVERNOR_DEFAULT_DECISION_INTERVAL
+#define FRAME_GOVERNOR_DEFAULT_DECISION_INTERVAL 30
+#endif /* FRAME_GOVERNOR_DEFAULT_DECISION_INTERVAL */
+
+// The budget is exceeded if frames take longer than this fraction of the target frame time
+#ifndef FRAME_GOVERNOR_DEFAULT_HIGH_WATERMARK
+#define FRAME_GOVERNOR_DEFAULT_HIGH_WATERMARK 0.9
+#endif /* FRAME_GOVERNOR_DEFAULT_HIGH_WATERMARK */
+
+// Quality is restored if frames take less than this fraction of the target frame time
+#ifndef FRAME_GOVERNOR_DEFAULT_LOW_WATERMARK
+#define FRAME_GOVERNOR_DEFAULT_LOW_WATERMARK 0.6
+#endif /* FRAME_GOVERNOR_DEFAULT_LOW_WATERMARK */
+
+// Lowest sub step count the governor falls back to
+#ifndef FRAME_GOVERNOR_DEFAULT_MIN_SUB_STEPS
+#define FRAME_GOVERNOR_DEFAULT_MIN_SUB_STEPS 2
+#endif /* FRAME_GOVERNOR_DEFAULT_MIN_SUB_STEPS */
+
+// Largest factor the spawn time interval is stretched by
+#ifndef FRAME_GOVERNOR_DEFAULT_MAX_SPAWN_SLOWDOWN
+#define FRAME_GOVERNOR_DEFAULT_MAX_SPAWN_SLOWDOWN 8.0
+#endif /* FRAME_GOVERNOR_DEFAULT_MAX_SPAWN_SLOWDOWN */
+
+typedef enum {
+    FRAME_GOVERNOR_PHASE_SIMULATION,
+    FRAME_GOVERNOR_PHASE_SNAPSHOT,
+    FRAME_GOVERNOR_PHASE_COUNT
+} FrameGovernorPhase;
+
+// Probing a different thread count and waiting for the next decision to judge it
+typedef struct {
+    bool pending;
+    size_t previous_section_count;
+    float previous_cost;
+} FrameGovernorThreadProbe;
+
+// Keeps the frame time of a `ParticleUpdater` within a budget by trading simulation quality for speed.
+// A frame is one batch of simulation steps and publishing their result, see `SimulationThread`.
+// When frames are too slow, the governor (in this order) searches for a faster thread count, lowers the
+// sub step count and slows down spawning. When there's time to spare, it undoes those steps in reverse order.
+typedef struct {
+    ParticleUpdater *updater;
+    float target_frame_time;
+    float high_watermark, low_watermark;
+    size_t decision_interval;
+
+    // Phase costs (in milliseconds), summed over the frames since the last decision
+    float phase_times[FRAME_GOVERNOR_PHASE_COUNT];
+    size_t simulation_steps;
+    size_t simulation_sub_steps;
+    size_t frames;
+    struct timespec phase_start;
+
+    // Sub steps: the governor lowers the sub step count (or the maximum, if the solver adapts them) down to `min_sub_steps`
+    size_t base_sub_steps;
+    size_t min_sub_steps;
+
+    // Spawn rate: the spawn time interval is stretched up to `max_spawn_slowdown` times its base value
+    float base_spawn_time_interval;
+    float max_spawn_slowdown;
+
+    // Set once there was nothing left to adjust, so that's only reported once. Cleared when quality is
+    // restored, since there is something to adjust again then.
+    bool exhausted;
+
+    // Thread count: optional, only if the solver splits its work into sections
+    size_t *section_count;
+    size_t max_section_count;
+    int thread_direction;
+    bool threads_settled;
+    size_t threads_settled_particles;
+    FrameGovernorThreadProbe thread_probe;
+} FrameGovernor;
+
+FrameGovernor frame_governor_new(ParticleUpdater *updater, float target_frame_time);
+void frame_governor_control_threads(FrameGovernor *governor, size_t *section_count, size_t max_section_count);
+void frame_governor_begin_phase(FrameGovernor *governor);
+void frame_governor_end_phase(FrameGovernor *governor, FrameGovernorPhase phase);
+void frame_governor_end_frame(FrameGovernor *governor);
+
+#endif /* FRAME_GOVERNOR_H */
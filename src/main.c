@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include <GL/glew.h>
 
@@ -10,18 +11,49 @@
 #include "../thirdparty/c_math2d.h"
 
 #include "camera/orthographic.h"
+#include "frame_capture.h"
+#include "governor.h"
 #include "opengl/debug.h"
+#include "opengl/program_cache.h"
+#include "opengl/render_state.h"
 #include "opengl/window.h"
 #include "particle/constraint.h"
 #include "particle/grid/grid.h"
+#include "particle/grid/density_renderer.h"
 #include "particle/grid/grid_renderer.h"
+#include "particle/obstacles/obstacle_renderer.h"
 #include "particle/renderer.h"
 #include "particle/solver/solver.h"
 #include "particle/solver/parallel_grid_based.h"
+#include "particle/solver/sph.h"
+#include "simulation_thread.h"
 #include "updater.h"
 #include "util/math.h"
 
+// Simulate the particles as a fluid (SPH) instead of as hard spheres
+#ifndef PARTICLE_SIMULATION_USE_SPH
+#define PARTICLE_SIMULATION_USE_SPH 0
+#endif /* PARTICLE_SIMULATION_USE_SPH */
+
+// Force field that follows the cursor, attracting while the primary button is held and repelling
+// while the secondary one is held
+typedef struct {
+    size_t field_idx;
+    float strength;
+} MouseField;
+
+static void apply_mouse_field(ParticleUpdater *updater, SimulationInput input, void *data) {
+    MouseField *mouse_field = data;
+    ForceField *field = &updater->force_fields.fields[mouse_field->field_idx];
+    field->center = input.cursor;
+    field->enabled = input.primary_pressed || input.secondary_pressed;
+    field->strength = input.secondary_pressed ? -mouse_field->strength : mouse_field->strength;
+}
+
 int main() {
+    struct timespec startup_start;
+    clock_gettime(CLOCK_MONOTONIC, &startup_start);
+
     if (!glfwInit()) {
         c_log(C_LOG_SEVERITY_ERROR, "Failed to initialize glfw");
         exit(EXIT_FAILURE);
@@ -61,17 +93,32 @@ int main() {
     particle_updater.particle_list = particle_list_new();
     particle_updater.particle_grid = particle_grid_new(56, 40, 20, 20);
 
-    // Create solver data
-    ParallelGridBasedSolverData solver_data;
-    solver_data.grid = &particle_updater.particle_grid;
-    solver_data.list = &particle_updater.particle_list;
-    solver_data.params.section_count = 8; // 56 / 8 = 7
-
-    // Create solver
+    // Create solver data and solver
     const float SOLVER_DT = 0.005;
     const float SOLVER_SUB_STEPS = 8;
+#if PARTICLE_SIMULATION_USE_SPH
+    // The smoothing radius is the cell size, so the neighbors of a particle are always in the 3x3 cells around it
+    SphSolverData solver_data = solver_sph_data_new(
+        &particle_updater.particle_grid,
+        &particle_updater.particle_list,
+        solver_sph_params_new(5.0, 20.0, 7)
+    );
+    particle_updater.solver = solver_sph_new(solver_new(SOLVER_DT, SOLVER_SUB_STEPS));
+#else
+    ParallelGridBasedSolverData solver_data = solver_parallel_grid_based_data_new(
+        &particle_updater.particle_grid,
+        &particle_updater.particle_list,
+        7 // 56 / 8 = 7 tile columns
+    );
+
     particle_updater.solver = solver_parallel_grid_based_new(solver_new(SOLVER_DT, SOLVER_SUB_STEPS));
+#endif /* PARTICLE_SIMULATION_USE_SPH */
     particle_updater.solver.update_data = &solver_data;
+    solver_enable_early_exit(&particle_updater.solver, 0.3, 1, 2);
+
+    // Speculative contacts keep the emitter jets from tunneling, so 2 to 4 sub steps are enough
+    solver_enable_speculative_contacts(&particle_updater.solver, SOLVER_DEFAULT_MAX_STEP_DISPLACEMENT_RATIO);
+    solver_enable_adaptive_sub_steps(&particle_updater.solver, 2, 4);
 
     // Create constraint
     particle_updater.solver.constraint = box_constraint_fit_grid(&particle_updater.particle_grid);
@@ -82,7 +129,7 @@ int main() {
     srand(time.tv_nsec);
 
     // Create emitters
-    particle_updater.particle_spawn_time_interval = 1.0;
+    particle_updater.particle_spawn_time_interval = particle_updater.step_interval; // One particle per emitter and step
 
     float grid_half_w = (particle_updater.particle_grid.width  * particle_updater.particle_grid.cell_width ) / 2.;
     float grid_half_h = (particle_updater.particle_grid.height * particle_updater.particle_grid.cell_height) / 2.;
@@ -105,39 +152,218 @@ int main() {
         6.0
     );
 
+    // Create a ramp out of static particles below the middle emitter
+    particle_updater.static_particles = static_particles_fit_grid(&particle_updater.particle_grid);
+    particle_updater.solver.static_particles = &particle_updater.static_particles;
+    static_particles_push_line(
+        &particle_updater.static_particles,
+        cm2_vec2_new(-150.0, 0.0),
+        cm2_vec2_new(150.0, -120.0),
+        6.0,
+        cm2_vec4_new(0.6, 0.6, 0.6, 1.0),
+        particle_collision_filter_default()
+    );
+
+    // Create obstacles: a funnel below the right emitter and a row of pegs next to it
+    particle_updater.obstacles = obstacles_fit_grid(&particle_updater.particle_grid, 8.0);
+    particle_updater.solver.obstacles = &particle_updater.obstacles;
+    obstacles_push_segment(&particle_updater.obstacles, cm2_vec2_new(220.0, 200.0), cm2_vec2_new(330.0, 100.0));
+    obstacles_push_segment(&particle_updater.obstacles, cm2_vec2_new(480.0, 200.0), cm2_vec2_new(370.0, 100.0));
+    for (size_t i = 0; i < 8; ++i) {
+        float peg_x = 220.0 + 35.0 * (float)i;
+        cm2_vec2 peg[] = {
+            cm2_vec2_new(peg_x, -40.0),
+            cm2_vec2_new(peg_x + 8.0, -48.0),
+            cm2_vec2_new(peg_x, -56.0),
+            cm2_vec2_new(peg_x - 8.0, -48.0),
+        };
+        obstacles_push_polygon(&particle_updater.obstacles, peg, 4);
+    }
+
+    // Create force fields: a vortex in the lower left and a field that follows the mouse
+    // (attracting while the left button is held, repelling while the right one is held)
+    particle_updater.force_fields = force_fields_new();
+    particle_updater.solver.force_fields = &particle_updater.force_fields;
+    force_fields_push(&particle_updater.force_fields, force_field_vortex(cm2_vec2_new(-300.0, -200.0), 8000.0, 150.0));
+
+    MouseField mouse_field;
+    mouse_field.strength = 30000.0;
+    mouse_field.field_idx = force_fields_push(
+        &particle_updater.force_fields,
+        force_field_radial(cm2_vec2_new(0.0, 0.0), mouse_field.strength, 150.0)
+    );
+
+    // Create a rope hanging from the top and a cloth strip held at its upper corners
+    particle_updater.links = particle_links_new(&solver_data.params.section_count);
+    particle_updater.solver.links = &particle_updater.links;
+
+    ParticleList *particle_list = &particle_updater.particle_list;
+    const float LINK_PARTICLE_RADIUS = 4.0;
+    const float LINK_LENGTH = 2.0 * LINK_PARTICLE_RADIUS;
+
+    cm2_vec2 rope_anchor = cm2_vec2_new(-120.0, 300.0);
+    size_t rope_start = particle_list->buffer_len;
+    for (size_t i = 0; i < 40; ++i) {
+        particle_list_push(particle_list, particle_new(
+            rope_anchor.x + LINK_LENGTH * (float)(i + 1), rope_anchor.y, LINK_PARTICLE_RADIUS, 0.9, 0.7, 0.3, 1.0
+        ));
+        if (i > 0) {
+            particle_links_push(&particle_updater.links, rope_start + i - 1, rope_start + i, LINK_LENGTH, 1.0);
+        }
+    }
+    particle_links_push_anchor(&particle_updater.links, rope_start, rope_anchor, LINK_LENGTH);
+
+    const size_t CLOTH_WIDTH = 24, CLOTH_HEIGHT = 8;
+    cm2_vec2 cloth_origin = cm2_vec2_new(-460.0, 120.0);
+    size_t cloth_start = particle_list->buffer_len;
+    for (size_t y = 0; y < CLOTH_HEIGHT; ++y) {
+        for (size_t x = 0; x < CLOTH_WIDTH; ++x) {
+            size_t idx = particle_list->buffer_len;
+            particle_list_push(particle_list, particle_new(
+                cloth_origin.x + LINK_LENGTH * (float)x, cloth_origin.y - LINK_LENGTH * (float)y,
+                LINK_PARTICLE_RADIUS, 0.3, 0.6, 0.9, 1.0
+            ));
+            if (x > 0) particle_links_push(&particle_updater.links, idx - 1, idx, LINK_LENGTH, 0.8);
+            if (y > 0) particle_links_push(&particle_updater.links, idx - CLOTH_WIDTH, idx, LINK_LENGTH, 0.8);
+        }
+    }
+    particle_links_push_anchor(&particle_updater.links, cloth_start, cloth_origin, 0.0);
+    particle_links_push_anchor(
+        &particle_updater.links,
+        cloth_start + CLOTH_WIDTH - 1,
+        particle_list->buffer[cloth_start + CLOTH_WIDTH - 1].position,
+        0.0
+    );
+
+    ObstacleRenderer obstacle_renderer = obstacle_renderer_new();
+    obstacle_renderer_upload(&obstacle_renderer, &particle_updater.obstacles);
+
+    // Static particles never change while the simulation runs, so like the obstacles, they're uploaded once
+    // before the simulation thread owns the updater
+    particle_renderer_upload_static(&renderer, &particle_updater.static_particles.list);
+
     // Create grid renderer
     GridRenderer grid_renderer = grid_renderer_from_particle_grid(&particle_updater.particle_grid);
 
+    // Create density renderer, which replaces the particles when zoomed out far
+    DensityRenderer density_renderer = density_renderer_from_particle_grid(&particle_updater.particle_grid);
+    size_t density_sequence = SIZE_MAX;
+
+    // Create frame governor, which keeps the simulation thread in real time
+    FrameGovernor governor = frame_governor_new(&particle_updater, particle_updater.step_interval);
+    frame_governor_control_threads(&governor, &solver_data.params.section_count, particle_updater.particle_grid.tiles_x);
+
+    // Run the simulation on its own thread. From here on, the updater belongs to that thread,
+    // this one only reads snapshots of it (static particles and obstacles were uploaded above).
+    // Snapshots only contain the particles around the view of the camera (pan with the middle mouse button,
+    // zoom with the scroll wheel).
+    SimulationThread simulation_thread = simulation_thread_new(&particle_updater);
+    simulation_thread.governor = &governor;
+    simulation_thread.cull_grid = &particle_updater.particle_grid;
+    simulation_thread.apply_input = apply_mouse_field;
+    simulation_thread.apply_input_data = &mouse_field;
+    simulation_thread_start(&simulation_thread);
+
+    // Recording of the window, toggled with F9
+    FrameCapture frame_capture = frame_capture_new(FRAME_CAPTURE_FORMAT_PPM);
+
+    struct timespec startup_end;
+    clock_gettime(CLOCK_MONOTONIC, &startup_end);
+    c_log(C_LOG_SEVERITY_INFO, "Startup took %.2f ms (program cache %s)", time_diff_ms(startup_start, startup_end),
+          PROGRAM_CACHE_ENABLED && program_cache_is_supported() ? "enabled" : "disabled");
+
     while (!glfwWindowShouldClose(window)) {
+        // Take the GL call counts of the last frame
+        RenderStateStats render_stats = render_state_end_frame();
+
         glClear(GL_COLOR_BUFFER_BIT);
         glClearColor(0.0, 0.0, 0.0, 1.0);
+        render_state_count_calls(2);
+
+        // Pick up the newest state of the simulation
+        ParticleSnapshot *snapshot = simulation_thread_read_snapshot(&simulation_thread);
+
+        // Pass the cursor to the mouse field and the view to culling
+        double cursor_x, cursor_y;
+        glfwGetCursorPos(window, &cursor_x, &cursor_y);
+        SimulationInput input;
+        input.cursor = ortho_camera_screen_to_world(&user_data.camera, cursor_x, cursor_y);
+        ortho_camera_view_rect(&user_data.camera, &input.view_min, &input.view_max);
+        input.primary_pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        input.secondary_pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+        input.density_lod = density_renderer_should_draw(&density_renderer, user_data.camera.zoom);
+        simulation_thread_set_input(&simulation_thread, input);
+
+        // Upload the state interpolated between the last two steps of the snapshot to the GPU
+        float alpha = particle_snapshot_interpolation_alpha(snapshot);
+        particle_renderer_upload_from_list(&renderer, &snapshot->particle_list, alpha, !snapshot->complete);
 
         // Update title
-        char title[50];
-        sprintf(title, "particle-simulation - Particles: %lu", particle_updater.particle_list.buffer_len);
+        char title[160];
+        snprintf(title, sizeof(title), "particle-simulation - Particles: %lu (%lu visible), Sub steps: %lu, Fill: %.2f ms, GL calls: %lu (%lu skipped)",
+                snapshot->total_particle_count, snapshot->particle_list.buffer_len,
+                snapshot->sub_steps, renderer.gpu_data.fill_time,
+                render_stats.calls, render_stats.skipped);
         glfwSetWindowTitle(window, title);
 
-        // Upload data to GPU
-        particle_updater_update(&particle_updater);
-        particle_renderer_upload_from_list(&renderer, &particle_updater.particle_list);
-
         // Draw grid
         shader_program_use(&grid_renderer.shader_program);
         shader_program_set_mat4(&grid_renderer.shader_program, "_MProj", user_data.camera.projection_matrix);
         grid_renderer_draw(&grid_renderer);
 
+        // Draw obstacles
+        shader_program_use(&obstacle_renderer.shader_program);
+        shader_program_set_mat4(&obstacle_renderer.shader_program, "_MProj", user_data.camera.projection_matrix);
+        obstacle_renderer_draw(&obstacle_renderer);
+
+        // Draw the density of the cells, if the snapshot has it instead of the particles
+        if (snapshot->has_density) {
+            if (snapshot->sequence != density_sequence) {
+                density_renderer_upload(&density_renderer, snapshot->density);
+                density_sequence = snapshot->sequence;
+            }
+
+            shader_program_use(&density_renderer.shader_program);
+            shader_program_set_mat4(&density_renderer.shader_program, "_MProj", user_data.camera.projection_matrix);
+            density_renderer_draw(&density_renderer);
+        }
+
         // Draw particles
         shader_program_use(&renderer.shader_program);
         shader_program_set_mat4(&renderer.shader_program, "_MProj", user_data.camera.projection_matrix);
         particle_renderer_draw(&renderer);
 
+        // Queue the read of the finished frame before it's swapped out
+        if (user_data.capturing != frame_capture.running) {
+            if (user_data.capturing) {
+                // Don't retry every frame, F9 has to be pressed again
+                user_data.capturing = frame_capture_start(&frame_capture);
+            } else {
+                frame_capture_stop(&frame_capture);
+            }
+        }
+        frame_capture_frame(&frame_capture, user_data.window_width, user_data.window_height);
+
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    frame_capture_stop(&frame_capture);
+    frame_capture_delete(&frame_capture);
+
+    simulation_thread_stop(&simulation_thread);
+    simulation_thread_delete(&simulation_thread);
+
     particle_updater_delete(&particle_updater);
+#if PARTICLE_SIMULATION_USE_SPH
+    solver_sph_data_delete(&solver_data);
+#else
+    solver_parallel_grid_based_data_delete(&solver_data);
+#endif /* PARTICLE_SIMULATION_USE_SPH */
 
     grid_renderer_delete(&grid_renderer);
+    density_renderer_delete(&density_renderer);
+    obstacle_renderer_delete(&obstacle_renderer);
     particle_renderer_delete(&renderer);
 
     glfwDestroyWindow(window);
@@ -1,4 +1,9 @@
 #include "buffer.h"
+#include "render_state.h"
+
+#include <stdlib.h>
+
+#include "../../thirdparty/c_log.h"
 
 Buffer buffer_new(GLenum target) {
     Buffer buffer = {0};
@@ -8,13 +13,203 @@ Buffer buffer_new(GLenum target) {
 }
 
 void buffer_bind(Buffer *buffer) {
-    glBindBuffer(buffer->target, buffer->handle);
+    render_state_bind_buffer(buffer->target, buffer->handle);
 }
 
 void buffer_upload_data_static(Buffer *buffer, void *data, size_t size) {
     glBufferData(buffer->target, size, data, GL_STATIC_DRAW);
+    render_state_count_calls(1);
 }
 
 void buffer_delete(Buffer *buffer) {
     glDeleteBuffers(1, &buffer->handle);
+    render_state_forget_buffer(buffer->handle);
+}
+
+// Flags of the persistent mapping. The mapping is coherent, so writes don't have to be flushed.
+#define STREAM_BUFFER_MAP_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+StreamBuffer stream_buffer_new(GLenum target) {
+    StreamBuffer stream_buffer = {0};
+    stream_buffer.buffer = buffer_new(target);
+    stream_buffer.persistent = GLEW_ARB_buffer_storage;
+    stream_buffer.region_size = 0;
+    stream_buffer.region = 0;
+    stream_buffer.data = NULL;
+    stream_buffer.written_offset = 0;
+    stream_buffer.written_size = 0;
+    for (size_t i = 0; i < STREAM_BUFFER_REGION_COUNT; ++i) {
+        stream_buffer.fences[i] = NULL;
+    }
+
+    c_log(C_LOG_SEVERITY_DEBUG, "Stream buffer: %s", stream_buffer.persistent ? "persistent mapping" : "orphaning");
+    return stream_buffer;
+}
+
+static void stream_buffer_wait_for_region(StreamBuffer *stream_buffer, size_t region) {
+    GLsync fence = stream_buffer->fences[region];
+    if (!fence) {
+        return;
+    }
+
+    // Only flush the commands on the first try, waiting again afterwards is enough
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;) {
+        GLenum result = glClientWaitSync(fence, flags, STREAM_BUFFER_FENCE_TIMEOUT);
+        render_state_count_calls(1);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+            break;
+        }
+        flags = 0;
+    }
+
+    glDeleteSync(fence);
+    render_state_count_calls(1);
+    stream_buffer->fences[region] = NULL;
+}
+
+static void stream_buffer_grow(StreamBuffer *stream_buffer, size_t size) {
+    size_t region_size = stream_buffer->region_size > 0 ? stream_buffer->region_size : 1024;
+    while (region_size < size) {
+        region_size *= 2; // Grow buffer capacity exponentially
+    }
+
+    c_log(C_LOG_SEVERITY_DEBUG, "Stream buffer reallocation: region size = %lu", region_size);
+    stream_buffer->region_size = region_size;
+
+    if (!stream_buffer->persistent) {
+        stream_buffer->data = realloc(stream_buffer->data, region_size);
+        return;
+    }
+
+    // Storage of a persistently mapped buffer is immutable, so a new buffer is created. Draws that still
+    // read from the old one keep it alive until they are done, so its fences aren't needed anymore.
+    for (size_t i = 0; i < STREAM_BUFFER_REGION_COUNT; ++i) {
+        if (stream_buffer->fences[i]) {
+            glDeleteSync(stream_buffer->fences[i]);
+            stream_buffer->fences[i] = NULL;
+        }
+    }
+
+    GLenum target = stream_buffer->buffer.target;
+    if (stream_buffer->data) {
+        buffer_bind(&stream_buffer->buffer);
+        glUnmapBuffer(target);
+    }
+    buffer_delete(&stream_buffer->buffer);
+
+    stream_buffer->buffer = buffer_new(target);
+    buffer_bind(&stream_buffer->buffer);
+    GLsizeiptr total_size = region_size * STREAM_BUFFER_REGION_COUNT;
+    glBufferStorage(target, total_size, NULL, STREAM_BUFFER_MAP_FLAGS);
+    stream_buffer->data = glMapBufferRange(target, 0, total_size, STREAM_BUFFER_MAP_FLAGS);
+    if (stream_buffer->data) {
+        return;
+    }
+
+    // The storage can't be mapped, so switch to orphaning. That needs mutable storage, i.e. a new buffer.
+    c_log(C_LOG_SEVERITY_WARNING, "Can't map stream buffer of size %lu, falling back to orphaning", total_size);
+    buffer_delete(&stream_buffer->buffer);
+    stream_buffer->buffer = buffer_new(target);
+    stream_buffer->persistent = false;
+    stream_buffer->data = malloc(region_size);
+}
+
+void *stream_buffer_begin_write(StreamBuffer *stream_buffer, size_t size) {
+    if (size > stream_buffer->region_size) {
+        stream_buffer_grow(stream_buffer, size);
+    }
+
+    stream_buffer->written_offset = 0;
+    stream_buffer->written_size = size;
+    if (!stream_buffer->persistent) {
+        return stream_buffer->data;
+    }
+
+    // Move on to the next region, waiting for the GPU if it still reads from it
+    stream_buffer->region = (stream_buffer->region + 1) % STREAM_BUFFER_REGION_COUNT;
+    stream_buffer_wait_for_region(stream_buffer, stream_buffer->region);
+    return (char *) stream_buffer->data + stream_buffer->region * stream_buffer->region_size;
+}
+
+bool stream_buffer_can_write_range(StreamBuffer *stream_buffer, size_t offset, size_t size) {
+    return offset + size <= stream_buffer->region_size;
+}
+
+void *stream_buffer_begin_write_range(StreamBuffer *stream_buffer, size_t offset, size_t size) {
+    // Stay in the current region, no draw has read the range yet
+    stream_buffer->written_offset = offset;
+    stream_buffer->written_size = size;
+    char *region = stream_buffer->data;
+    if (stream_buffer->persistent) {
+        region += stream_buffer->region * stream_buffer->region_size;
+    }
+
+    return region + offset;
+}
+
+void stream_buffer_end_write(StreamBuffer *stream_buffer) {
+    if (stream_buffer->persistent) {
+        // The mapping is coherent, the data is visible to the next draws
+        return;
+    }
+
+    buffer_bind(&stream_buffer->buffer);
+    GLenum target = stream_buffer->buffer.target;
+    size_t offset = stream_buffer->written_offset;
+    size_t size = stream_buffer->written_size;
+
+    if (offset > 0) {
+        // Only a range was written, upload just that range into the existing storage
+        glBufferSubData(target, offset, size, (char *) stream_buffer->data + offset);
+        render_state_count_calls(1);
+        return;
+    }
+
+    // Orphan the old storage and upload the data into new storage
+    glBufferData(target, stream_buffer->region_size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, size, stream_buffer->data);
+    render_state_count_calls(2);
+}
+
+size_t stream_buffer_offset(StreamBuffer *stream_buffer) {
+    if (!stream_buffer->persistent) {
+        return 0;
+    }
+
+    return stream_buffer->region * stream_buffer->region_size;
+}
+
+void stream_buffer_fence(StreamBuffer *stream_buffer) {
+    if (!stream_buffer->persistent) {
+        return;
+    }
+
+    // Only the last draw from the region matters
+    size_t region = stream_buffer->region;
+    if (stream_buffer->fences[region]) {
+        glDeleteSync(stream_buffer->fences[region]);
+        render_state_count_calls(1);
+    }
+    stream_buffer->fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    render_state_count_calls(1);
+}
+
+void stream_buffer_delete(StreamBuffer *stream_buffer) {
+    for (size_t i = 0; i < STREAM_BUFFER_REGION_COUNT; ++i) {
+        if (stream_buffer->fences[i]) {
+            glDeleteSync(stream_buffer->fences[i]);
+        }
+    }
+
+    if (stream_buffer->persistent) {
+        if (stream_buffer->data) {
+            buffer_bind(&stream_buffer->buffer);
+            glUnmapBuffer(stream_buffer->buffer.target);
+        }
+    } else {
+        free(stream_buffer->data);
+    }
+
+    buffer_delete(&stream_buffer->buffer);
 }
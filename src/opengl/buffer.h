@@ -3,6 +3,18 @@
 
 #include <GL/glew.h>
 
+#include <stdbool.h>
+
+// Number of regions of a stream buffer. While the CPU writes one region, the GPU can still read from the others.
+#ifndef STREAM_BUFFER_REGION_COUNT
+#define STREAM_BUFFER_REGION_COUNT 3
+#endif /* STREAM_BUFFER_REGION_COUNT */
+
+// Longest time (in nanoseconds) that is waited for the GPU to release a region before waiting is retried
+#ifndef STREAM_BUFFER_FENCE_TIMEOUT
+#define STREAM_BUFFER_FENCE_TIMEOUT 1000000
+#endif /* STREAM_BUFFER_FENCE_TIMEOUT */
+
 typedef struct {
     GLenum target;
     GLuint handle;
@@ -13,4 +25,46 @@ void buffer_bind(Buffer *buffer);
 void buffer_upload_data_static(Buffer *buffer, void *data, size_t size);
 void buffer_delete(Buffer *buffer);
 
+// Buffer for data that is written by the CPU every frame.
+//
+// If persistent mapping is available (ARB_buffer_storage), the buffer is split into STREAM_BUFFER_REGION_COUNT regions
+// that stay mapped for the lifetime of the buffer. Every write goes to the next region, after waiting for the fence
+// placed behind the last draw that read from it. Callers write straight into the mapped memory.
+//
+// Otherwise, writes go to memory on the CPU side, which is uploaded with `glBufferSubData` after orphaning
+// the buffer storage (so the driver doesn't have to wait for draws that still read the old data).
+typedef struct {
+    Buffer buffer;
+    bool persistent;
+
+    // Size of one region in bytes
+    size_t region_size;
+    size_t region;
+
+    // Persistent: mapping of all regions. Otherwise: memory that is uploaded in `stream_buffer_end_write`.
+    void *data;
+
+    // Byte range of the last write
+    size_t written_offset, written_size;
+
+    GLsync fences[STREAM_BUFFER_REGION_COUNT];
+} StreamBuffer;
+
+StreamBuffer stream_buffer_new(GLenum target);
+// Returns memory for `size` bytes that are used by the next draws, growing the buffer if needed.
+// Growing the buffer replaces its handle.
+void *stream_buffer_begin_write(StreamBuffer *stream_buffer, size_t size);
+// Whether the range fits into the buffer without growing it
+bool stream_buffer_can_write_range(StreamBuffer *stream_buffer, size_t offset, size_t size);
+// Returns memory for the bytes [offset, offset + size) of the last written data, keeping the rest of it.
+// The range is written in place, so it must not have been read by any draw yet (e.g. because it was appended),
+// and it has to fit into the buffer (see `stream_buffer_can_write_range`).
+void *stream_buffer_begin_write_range(StreamBuffer *stream_buffer, size_t offset, size_t size);
+void stream_buffer_end_write(StreamBuffer *stream_buffer);
+// Offset of the last written data in the buffer, in bytes
+size_t stream_buffer_offset(StreamBuffer *stream_buffer);
+// Marks the last written region as in use by the draws that were issued so far
+void stream_buffer_fence(StreamBuffer *stream_buffer);
+void stream_buffer_delete(StreamBuffer *stream_buffer);
+
 #endif /* BUFFER_H */
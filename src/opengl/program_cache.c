@@ -0,0 +1,139 @@
+#include "program_cache.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "../../thirdparty/c_log.h"
+
+#define PROGRAM_CACHE_FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define PROGRAM_CACHE_FNV_PRIME 0x100000001b3ull
+
+bool program_cache_is_supported() {
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) {
+        return false;
+    }
+
+    GLint format_count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    return format_count > 0;
+}
+
+// FNV-1a, including the terminating null character so that the boundaries between the strings are hashed too
+static uint64_t program_cache_hash_string(uint64_t hash, const char *string) {
+    if (!string) {
+        string = "";
+    }
+
+    for (const unsigned char *c = (const unsigned char *) string; ; ++c) {
+        hash ^= *c;
+        hash *= PROGRAM_CACHE_FNV_PRIME;
+        if (*c == '\0') {
+            break;
+        }
+    }
+
+    return hash;
+}
+
+uint64_t program_cache_key(char *vert_source, char *frag_source) {
+    uint64_t hash = PROGRAM_CACHE_FNV_OFFSET_BASIS;
+    hash = program_cache_hash_string(hash, vert_source);
+    hash = program_cache_hash_string(hash, frag_source);
+    hash = program_cache_hash_string(hash, (const char *) glGetString(GL_VENDOR));
+    hash = program_cache_hash_string(hash, (const char *) glGetString(GL_RENDERER));
+    hash = program_cache_hash_string(hash, (const char *) glGetString(GL_VERSION));
+    return hash;
+}
+
+static void program_cache_path(char *path, size_t path_size, uint64_t key) {
+    snprintf(path, path_size, "%s/%016" PRIx64 ".bin", PROGRAM_CACHE_DEFAULT_DIRECTORY, key);
+}
+
+bool program_cache_load(GLuint program, uint64_t key) {
+    char path[256];
+    program_cache_path(path, sizeof(path), key);
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    ProgramCacheHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != PROGRAM_CACHE_MAGIC || header.key != key) {
+        c_log(C_LOG_SEVERITY_WARNING, "Ignoring invalid program cache file '%s'", path);
+        fclose(file);
+        return false;
+    }
+
+    void *binary = malloc(header.length);
+    if (!binary || fread(binary, 1, header.length, file) != header.length) {
+        c_log(C_LOG_SEVERITY_WARNING, "Ignoring truncated program cache file '%s'", path);
+        free(binary);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    // The driver may still reject the binary (e.g. after an update that kept the version string),
+    // which leaves the program unlinked
+    glProgramBinary(program, header.format, binary, (GLsizei) header.length);
+    free(binary);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        c_log(C_LOG_SEVERITY_INFO, "Driver rejected cached program '%s', compiling it again", path);
+    }
+    return success;
+}
+
+void program_cache_store(GLuint program, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    ProgramCacheHeader header;
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.key = key;
+
+    void *binary = malloc(length);
+    GLsizei binary_length = 0;
+    GLenum format;
+    glGetProgramBinary(program, length, &binary_length, &format, binary);
+    header.format = format;
+    header.length = binary_length;
+
+    if (mkdir(PROGRAM_CACHE_DEFAULT_DIRECTORY, 0755) != 0 && errno != EEXIST) {
+        c_log(C_LOG_SEVERITY_WARNING, "Can't create program cache directory '%s'", PROGRAM_CACHE_DEFAULT_DIRECTORY);
+        free(binary);
+        return;
+    }
+
+    // Write to a temporary file first and rename it, so that other instances never read a half written file
+    char path[256], temp_path[272];
+    program_cache_path(path, sizeof(path), key);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE *file = fopen(temp_path, "wb");
+    if (!file) {
+        c_log(C_LOG_SEVERITY_WARNING, "Can't write program cache file '%s'", temp_path);
+        free(binary);
+        return;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(binary, 1, header.length, file) == header.length;
+    written = fclose(file) == 0 && written;
+    free(binary);
+
+    if (!written || rename(temp_path, path) != 0) {
+        c_log(C_LOG_SEVERITY_WARNING, "Can't write program cache file '%s'", path);
+        remove(temp_path);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+// Directory (relative to the working directory, like the shaders) that the program binaries are cached in
+#ifndef PROGRAM_CACHE_DEFAULT_DIRECTORY
+#define PROGRAM_CACHE_DEFAULT_DIRECTORY "shader_cache"
+#endif /* PROGRAM_CACHE_DEFAULT_DIRECTORY */
+
+// Set to 0 to always compile the shaders from source
+#ifndef PROGRAM_CACHE_ENABLED
+#define PROGRAM_CACHE_ENABLED 1
+#endif /* PROGRAM_CACHE_ENABLED */
+
+// Written at the start of every cache file, followed by `length` bytes of the program binary
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+    uint64_t length;
+} ProgramCacheHeader;
+
+#define PROGRAM_CACHE_MAGIC 0x31425350u // "PSB1"
+
+// Program binaries need OpenGL 4.1 or ARB_get_program_binary, and a driver that supports at least one
+// binary format
+bool program_cache_is_supported();
+
+// Hash of the shader sources and the driver (vendor, renderer and version strings). Binaries are only valid
+// for the driver that created them, so a driver update changes the key and the program is compiled again.
+uint64_t program_cache_key(char *vert_source, char *frag_source);
+
+// Loads the cached binary of `key` into `program`. Returns false if there is no cached binary or the driver
+// rejects it, in which case the program has to be compiled and linked from source.
+bool program_cache_load(GLuint program, uint64_t key);
+// Stores the binary of a linked program. The program should be linked with
+// `GL_PROGRAM_BINARY_RETRIEVABLE_HINT` set.
+void program_cache_store(GLuint program, uint64_t key);
+
+#endif /* PROGRAM_CACHE_H */
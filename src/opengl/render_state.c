@@ -0,0 +1,107 @@
+#include "render_state.h"
+
+static RenderState render_state = {
+    .buffer_targets = {
+        GL_ARRAY_BUFFER,
+        GL_ELEMENT_ARRAY_BUFFER,
+        GL_PIXEL_PACK_BUFFER,
+        GL_PIXEL_UNPACK_BUFFER
+    }
+};
+
+void render_state_use_program(GLuint program) {
+    if (render_state.program == program) {
+        render_state.stats.skipped++;
+        return;
+    }
+
+    glUseProgram(program);
+    render_state.program = program;
+    render_state.stats.calls++;
+}
+
+static size_t render_state_buffer_slot(GLenum target) {
+    for (size_t i = 0; i < RENDER_STATE_BUFFER_TARGET_COUNT; ++i) {
+        if (render_state.buffer_targets[i] == target) {
+            return i;
+        }
+    }
+
+    return RENDER_STATE_BUFFER_TARGET_COUNT;
+}
+
+void render_state_bind_vao(GLuint vao) {
+    if (render_state.vao == vao) {
+        render_state.stats.skipped++;
+        return;
+    }
+
+    glBindVertexArray(vao);
+    render_state.vao = vao;
+    render_state.stats.calls++;
+
+    // The new VAO has its own element array buffer, which isn't known
+    render_state.buffers[render_state_buffer_slot(GL_ELEMENT_ARRAY_BUFFER)] = (GLuint)-1;
+}
+
+void render_state_bind_buffer(GLenum target, GLuint buffer) {
+    size_t slot = render_state_buffer_slot(target);
+    if (slot < RENDER_STATE_BUFFER_TARGET_COUNT && render_state.buffers[slot] == buffer) {
+        render_state.stats.skipped++;
+        return;
+    }
+
+    glBindBuffer(target, buffer);
+    render_state.stats.calls++;
+    if (slot < RENDER_STATE_BUFFER_TARGET_COUNT) {
+        render_state.buffers[slot] = buffer;
+    }
+}
+
+void render_state_bind_texture_2d(GLuint texture) {
+    if (render_state.texture_2d == texture) {
+        render_state.stats.skipped++;
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    render_state.texture_2d = texture;
+    render_state.stats.calls++;
+}
+
+void render_state_forget_program(GLuint program) {
+    if (render_state.program == program) {
+        render_state.program = 0;
+    }
+}
+
+void render_state_forget_vao(GLuint vao) {
+    if (render_state.vao == vao) {
+        render_state.vao = 0;
+    }
+}
+
+void render_state_forget_buffer(GLuint buffer) {
+    for (size_t i = 0; i < RENDER_STATE_BUFFER_TARGET_COUNT; ++i) {
+        if (render_state.buffers[i] == buffer) {
+            render_state.buffers[i] = 0;
+        }
+    }
+}
+
+void render_state_forget_texture(GLuint texture) {
+    if (render_state.texture_2d == texture) {
+        render_state.texture_2d = 0;
+    }
+}
+
+void render_state_count_calls(size_t count) {
+    render_state.stats.calls += count;
+}
+
+RenderStateStats render_state_end_frame() {
+    RenderStateStats stats = render_state.stats;
+    render_state.stats.calls = 0;
+    render_state.stats.skipped = 0;
+    return stats;
+}
@@ -0,0 +1,47 @@
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+
+// Number of buffer targets whose binding is tracked
+#define RENDER_STATE_BUFFER_TARGET_COUNT 4
+
+typedef struct {
+    // GL calls that were issued, and binds that were dropped because the object was already bound
+    size_t calls;
+    size_t skipped;
+} RenderStateStats;
+
+// Cache of the bound GL objects of the context. Binding an object that is already bound is skipped, so callers
+// can bind what they need without knowing what was drawn before. All GL calls have to be made on one thread.
+//
+// The element array buffer binding belongs to the VAO, so it's forgotten whenever a different VAO is bound.
+typedef struct {
+    GLuint program;
+    GLuint vao;
+    GLenum buffer_targets[RENDER_STATE_BUFFER_TARGET_COUNT];
+    GLuint buffers[RENDER_STATE_BUFFER_TARGET_COUNT];
+    GLuint texture_2d;
+
+    RenderStateStats stats;
+} RenderState;
+
+void render_state_use_program(GLuint program);
+void render_state_bind_vao(GLuint vao);
+void render_state_bind_buffer(GLenum target, GLuint buffer);
+void render_state_bind_texture_2d(GLuint texture);
+
+// Objects that are deleted are unbound by GL, and their names can be reused
+void render_state_forget_program(GLuint program);
+void render_state_forget_vao(GLuint vao);
+void render_state_forget_buffer(GLuint buffer);
+void render_state_forget_texture(GLuint texture);
+
+// Counts GL calls that don't go through the render state (draws, uploads, attribute setup, ...)
+void render_state_count_calls(size_t count);
+// Returns the stats since the last call and starts counting again
+RenderStateStats render_state_end_frame();
+
+#endif /* RENDER_STATE_H */
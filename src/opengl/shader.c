@@ -1,6 +1,12 @@
 #include "shader.h"
+#include "program_cache.h"
+#include "render_state.h"
+
+#include <string.h>
+#include <time.h>
 
 #include "../util/io.h"
+#include "../util/math.h"
 
 #include "../../thirdparty/c_log.h"
 
@@ -45,30 +51,29 @@ void shader_delete(Shader *shader) {
 
 ShaderProgram shader_program_new() {
     GLuint handle = glCreateProgram();
-    return (ShaderProgram) { handle };
+    return (ShaderProgram) { handle, NULL, 0 };
 }
 
-ShaderProgram shader_program_load_from_file(char *vert_path, char *frag_path) {
-    // Read shaders from file
-    char *vert_source = io_read_file(vert_path);
+static void shader_program_resolve_uniforms(ShaderProgram *shader_program);
+
+static ShaderProgram shader_program_compile_and_link(char *vert_source, char *frag_source, bool retrievable) {
     Shader vert_shader = shader_new(GL_VERTEX_SHADER);
     shader_compile_source(&vert_shader, vert_source);
     if (!shader_log_status(&vert_shader)) {
         exit(EXIT_FAILURE);
     }
 
-    char *frag_source = io_read_file(frag_path);
     Shader frag_shader = shader_new(GL_FRAGMENT_SHADER);
     shader_compile_source(&frag_shader, frag_source);
-    if (!shader_log_status(&vert_shader)) {
+    if (!shader_log_status(&frag_shader)) {
         exit(EXIT_FAILURE);
     }
 
-    free(vert_source);
-    free(frag_source);
-
     // Create shader program
     ShaderProgram shader_program = shader_program_new();
+    if (retrievable) {
+        glProgramParameteri(shader_program.handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     shader_program_attach(&shader_program, &vert_shader);
     shader_program_attach(&shader_program, &frag_shader);
     shader_program_link(&shader_program);
@@ -76,6 +81,47 @@ ShaderProgram shader_program_load_from_file(char *vert_path, char *frag_path) {
         exit(EXIT_FAILURE);
     }
 
+    // The program keeps the compiled code, the shaders aren't needed anymore
+    shader_delete(&vert_shader);
+    shader_delete(&frag_shader);
+
+    return shader_program;
+}
+
+ShaderProgram shader_program_load_from_file(char *vert_path, char *frag_path) {
+    struct timespec load_start, load_end;
+    clock_gettime(CLOCK_MONOTONIC, &load_start);
+
+    // Read shaders from file
+    char *vert_source = io_read_file(vert_path);
+    char *frag_source = io_read_file(frag_path);
+    if (!vert_source || !frag_source) {
+        exit(EXIT_FAILURE);
+    }
+
+    bool use_cache = PROGRAM_CACHE_ENABLED && program_cache_is_supported();
+    uint64_t key = use_cache ? program_cache_key(vert_source, frag_source) : 0;
+
+    // Try the cached binary first, and compile the program from source if there is none
+    ShaderProgram shader_program = shader_program_new();
+    bool cached = use_cache && program_cache_load(shader_program.handle, key);
+    if (cached) {
+        shader_program_resolve_uniforms(&shader_program);
+    } else {
+        shader_program_delete(&shader_program);
+        shader_program = shader_program_compile_and_link(vert_source, frag_source, use_cache);
+        if (use_cache) {
+            program_cache_store(shader_program.handle, key);
+        }
+    }
+
+    free(vert_source);
+    free(frag_source);
+
+    clock_gettime(CLOCK_MONOTONIC, &load_end);
+    c_log(C_LOG_SEVERITY_DEBUG, "Loaded program '%s' + '%s' %s in %.2f ms", vert_path, frag_path,
+          cached ? "from the cache" : "from source", time_diff_ms(load_start, load_end));
+
     return shader_program;
 }
 
@@ -83,8 +129,44 @@ void shader_program_attach(ShaderProgram *shader_program, Shader *shader) {
     glAttachShader(shader_program->handle, shader->handle);
 }
 
+static void shader_program_resolve_uniforms(ShaderProgram *shader_program) {
+    free(shader_program->uniforms);
+    shader_program->uniforms = NULL;
+    shader_program->uniforms_len = 0;
+
+    GLint uniform_count = 0;
+    glGetProgramiv(shader_program->handle, GL_ACTIVE_UNIFORMS, &uniform_count);
+    if (uniform_count <= 0) {
+        return;
+    }
+
+    shader_program->uniforms = (ShaderUniform *) malloc(sizeof(ShaderUniform) * uniform_count);
+    for (GLint i = 0; i < uniform_count; ++i) {
+        ShaderUniform *uniform = &shader_program->uniforms[shader_program->uniforms_len];
+        GLint size;
+        GLenum type;
+        GLsizei name_length = 0;
+        glGetActiveUniform(shader_program->handle, (GLuint) i, SHADER_PROGRAM_MAX_UNIFORM_NAME_LENGTH, &name_length, &size, &type, uniform->name);
+
+        // Longer names would have been cut off
+        if (name_length >= SHADER_PROGRAM_MAX_UNIFORM_NAME_LENGTH - 1) {
+            c_log(C_LOG_SEVERITY_WARNING, "Uniform name too long to cache: %s...", uniform->name);
+            continue;
+        }
+
+        uniform->location = glGetUniformLocation(shader_program->handle, uniform->name);
+        shader_program->uniforms_len++;
+    }
+}
+
 void shader_program_link(ShaderProgram *shader_program) {
     glLinkProgram(shader_program->handle);
+
+    int success;
+    glGetProgramiv(shader_program->handle, GL_LINK_STATUS, &success);
+    if (success) {
+        shader_program_resolve_uniforms(shader_program);
+    }
 }
 
 int shader_program_log_status(ShaderProgram *shader_program) {
@@ -112,38 +194,51 @@ int shader_program_log_status(ShaderProgram *shader_program) {
 }
 
 GLint shader_program_get_uniform_location(ShaderProgram *shader_program, char *name) {
-    return glGetUniformLocation(shader_program->handle, name);
+    for (size_t i = 0; i < shader_program->uniforms_len; ++i) {
+        if (strcmp(shader_program->uniforms[i].name, name) == 0) {
+            return shader_program->uniforms[i].location;
+        }
+    }
+
+    return -1;
 }
 
 void shader_program_set_bool(ShaderProgram *shader_program, char *name, bool value) {
     GLint location = shader_program_get_uniform_location(shader_program, name);
     glUniform1i(location, value);
+    render_state_count_calls(1);
 }
 
 void shader_program_set_int(ShaderProgram *shader_program, char *name, int value) {
     GLint location = shader_program_get_uniform_location(shader_program, name);
     glUniform1i(location, value);
+    render_state_count_calls(1);
 }
 
 void shader_program_set_float(ShaderProgram *shader_program, char *name, float value) {
     GLint location = shader_program_get_uniform_location(shader_program, name);
-    glUniform1i(location, value);
+    glUniform1f(location, value);
+    render_state_count_calls(1);
 }
 
 void shader_program_set_vec4(ShaderProgram *shader_program, char *name, cm2_vec4 value) {
     GLint location = shader_program_get_uniform_location(shader_program, name);
     glUniform4f(location, value.x, value.y, value.z, value.w);
+    render_state_count_calls(1);
 }
 
 void shader_program_set_mat4(ShaderProgram *shader_program, char *name, cm2_mat4 value) {
     GLint location = shader_program_get_uniform_location(shader_program, name);
     glUniformMatrix4fv(location, 1, GL_FALSE, cm2_mat4_value_ptr(value));
+    render_state_count_calls(1);
 }
 
 void shader_program_use(ShaderProgram *shader_program) {
-    glUseProgram(shader_program->handle);
+    render_state_use_program(shader_program->handle);
 }
 
 void shader_program_delete(ShaderProgram *shader_program) {
     glDeleteProgram(shader_program->handle);
+    render_state_forget_program(shader_program->handle);
+    free(shader_program->uniforms);
 }
@@ -17,8 +17,23 @@ void shader_compile_source(Shader *shader, char *source);
 int shader_log_status(Shader *shader);
 void shader_delete(Shader *shader);
 
+// Longest uniform name (including the terminating null character) whose location is cached
+#ifndef SHADER_PROGRAM_MAX_UNIFORM_NAME_LENGTH
+#define SHADER_PROGRAM_MAX_UNIFORM_NAME_LENGTH 64
+#endif /* SHADER_PROGRAM_MAX_UNIFORM_NAME_LENGTH */
+
+typedef struct {
+    char name[SHADER_PROGRAM_MAX_UNIFORM_NAME_LENGTH];
+    GLint location;
+} ShaderUniform;
+
 typedef struct {
     GLuint handle;
+
+    // Locations of the active uniforms, resolved when the program is linked. Programs only have a few
+    // uniforms, so looking them up by name is a short linear search without a round trip to the driver.
+    ShaderUniform *uniforms;
+    size_t uniforms_len;
 } ShaderProgram;
 
 ShaderProgram shader_program_new();
@@ -28,6 +43,7 @@ void shader_program_attach(ShaderProgram *shader_program, Shader *shader);
 void shader_program_link(ShaderProgram *shader_program);
 int shader_program_log_status(ShaderProgram *shader_program);
 
+// Returns -1 if the program has no active uniform of that name, which GL ignores when setting it
 GLint shader_program_get_uniform_location(ShaderProgram *shader_program, char *name);
 void shader_program_set_bool(ShaderProgram *shader_program, char *name, bool value);
 void shader_program_set_int(ShaderProgram *shader_program, char *name, int value);
@@ -1,4 +1,5 @@
 #include "vao.h"
+#include "render_state.h"
 
 Vao vao_new() {
     Vao vao = {0};
@@ -7,9 +8,10 @@ Vao vao_new() {
 }
 
 void vao_bind(Vao *vao) {
-    glBindVertexArray(vao->handle);
+    render_state_bind_vao(vao->handle);
 }
 
 void vao_delete(Vao *vao) {
     glDeleteVertexArrays(1, &vao->handle);
+    render_state_forget_vao(vao->handle);
 }
@@ -1,5 +1,7 @@
 #include "window.h"
 
+#include <math.h>
+
 #include "../../thirdparty/c_log.h"
 
 void window_error_callback(int error, const char *description) {
@@ -15,6 +17,49 @@ void window_framebuffer_size_callback(GLFWwindow *window, int width, int height)
     ortho_camera_on_window_resize(&user_ptr->camera, width, height);
 }
 
+void window_scroll_callback(GLFWwindow *window, double offset_x, double offset_y) {
+    (void)offset_x;
+    WindowUserData *user_ptr = (WindowUserData *) glfwGetWindowUserPointer(window);
+
+    // Zoom towards the cursor
+    double cursor_x, cursor_y;
+    glfwGetCursorPos(window, &cursor_x, &cursor_y);
+    ortho_camera_zoom_at(&user_ptr->camera, powf(ORTHO_CAMERA_ZOOM_STEP, (float)offset_y), cursor_x, cursor_y);
+}
+
+void window_mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    (void)mods;
+    if (button != GLFW_MOUSE_BUTTON_MIDDLE) {
+        return;
+    }
+
+    WindowUserData *user_ptr = (WindowUserData *) glfwGetWindowUserPointer(window);
+    user_ptr->panning = action == GLFW_PRESS;
+    glfwGetCursorPos(window, &user_ptr->last_cursor_x, &user_ptr->last_cursor_y);
+}
+
+void window_cursor_pos_callback(GLFWwindow *window, double x, double y) {
+    WindowUserData *user_ptr = (WindowUserData *) glfwGetWindowUserPointer(window);
+    if (user_ptr->panning) {
+        ortho_camera_pan(&user_ptr->camera, x - user_ptr->last_cursor_x, y - user_ptr->last_cursor_y);
+    }
+
+    user_ptr->last_cursor_x = x;
+    user_ptr->last_cursor_y = y;
+}
+
+void window_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    (void)scancode;
+    (void)mods;
+
+    if (key != GLFW_KEY_F9 || action != GLFW_PRESS) {
+        return;
+    }
+
+    WindowUserData *user_ptr = (WindowUserData *) glfwGetWindowUserPointer(window);
+    user_ptr->capturing = !user_ptr->capturing;
+}
+
 GLFWwindow *window_create_from_params(WindowParameters parameters) {
     glfwSetErrorCallback(window_error_callback);
 
@@ -40,5 +85,9 @@ GLFWwindow *window_create_from_params(WindowParameters parameters) {
     }
 
     glfwSetFramebufferSizeCallback(window, window_framebuffer_size_callback);
+    glfwSetScrollCallback(window, window_scroll_callback);
+    glfwSetMouseButtonCallback(window, window_mouse_button_callback);
+    glfwSetCursorPosCallback(window, window_cursor_pos_callback);
+    glfwSetKeyCallback(window, window_key_callback);
     return window;
 }
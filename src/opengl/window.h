@@ -10,10 +10,21 @@
 typedef struct {
     OrthoCamera camera;
     int window_width, window_height;
+
+    // The camera is panned while the middle mouse button is held, following the cursor from its last position
+    bool panning;
+    double last_cursor_x, last_cursor_y;
+
+    // Toggled with F9, frames are captured while this is set
+    bool capturing;
 } WindowUserData;
 
 void window_error_callback(int error, const char *description);
 void window_framebuffer_size_callback(GLFWwindow *window, int width, int height);
+void window_scroll_callback(GLFWwindow *window, double offset_x, double offset_y);
+void window_mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+void window_cursor_pos_callback(GLFWwindow *window, double x, double y);
+void window_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
 typedef struct {
     Version context_version;
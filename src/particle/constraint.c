@@ -2,6 +2,28 @@
 
 #include <stdlib.h>
 
+Constraint *constraint_new(void *data, ApplyConstraintFn apply, BakeConstraintFn bake, ApplyConstraintFn apply_baked) {
+    Constraint *constraint = (Constraint*) malloc(sizeof(Constraint));
+    constraint->data = data;
+    constraint->apply = apply;
+    constraint->bake = bake;
+    constraint->apply_baked = apply_baked;
+    constraint->is_baked = false;
+    constraint->baked_radius = 0.0;
+    return constraint;
+}
+
+void constraint_bake_uniform_radius(Constraint *constraint, float radius) {
+    // Nothing to do if there's no specialization or it is baked for this radius already
+    if (!constraint->bake || (constraint->is_baked && constraint->baked_radius == radius)) {
+        return;
+    }
+
+    constraint->bake(constraint, radius);
+    constraint->is_baked = true;
+    constraint->baked_radius = radius;
+}
+
 void constraint_delete(Constraint *constraint) {
     free(constraint->data);
 }
@@ -21,15 +43,38 @@ void circular_constraint_apply(struct Constraint *constraint, Particle *particle
     }
 }
 
+void circular_constraint_bake(struct Constraint *constraint, float radius) {
+    CircularConstraint *constraint_data = (CircularConstraint*) constraint->data;
+    constraint_data->baked_radius_diff = constraint_data->radius - radius;
+}
+
+void circular_constraint_apply_baked(struct Constraint *constraint, Particle *particle) {
+    CircularConstraint *constraint_data = (CircularConstraint*) constraint->data;
+    cm2_vec2 to_obj = cm2_vec2_sub(particle->position, constraint_data->center);
+
+    // Compare squared distances first, so the square root is only needed for particles outside
+    float radius_diff = constraint_data->baked_radius_diff;
+    float dist_sq = to_obj.x * to_obj.x + to_obj.y * to_obj.y;
+    if (dist_sq > radius_diff * radius_diff) {
+        float dist = sqrtf(dist_sq);
+        cm2_vec2 normal = cm2_vec2_scale(to_obj, 1.0 / dist);
+        cm2_vec2 vec_to_constraint_edge = cm2_vec2_scale(normal, radius_diff);
+
+        particle->position = cm2_vec2_add(constraint_data->center, vec_to_constraint_edge);
+    }
+}
+
 Constraint *circular_constraint_new(cm2_vec2 center, float radius) {
     CircularConstraint *circular_constraint = (CircularConstraint*) malloc(sizeof(CircularConstraint));
     circular_constraint->center = center;
     circular_constraint->radius = radius;
 
-    Constraint *constraint = (Constraint*) malloc(sizeof(Constraint));
-    constraint->data = circular_constraint;
-    constraint->apply = circular_constraint_apply;
-    return constraint;
+    return constraint_new(
+        circular_constraint,
+        circular_constraint_apply,
+        circular_constraint_bake,
+        circular_constraint_apply_baked
+    );
 }
 
 
@@ -53,15 +98,41 @@ void box_constraint_apply(struct Constraint *constraint, Particle *particle) {
     else if (p_pos.y > max_y) particle->position.y = max_y;
 }
 
+void box_constraint_bake(struct Constraint *constraint, float radius) {
+    BoxConstraint *constraint_data = (BoxConstraint*) constraint->data;
+    constraint_data->baked_min = cm2_vec2_new(constraint_data->min.x + radius, constraint_data->min.y + radius);
+    constraint_data->baked_max = cm2_vec2_new(constraint_data->max.x - radius, constraint_data->max.y - radius);
+}
+
+void box_constraint_apply_baked(struct Constraint *constraint, Particle *particle) {
+    BoxConstraint *constraint_data = (BoxConstraint*) constraint->data;
+
+    cm2_vec2 p_pos = particle->position;
+    cm2_vec2 min = constraint_data->baked_min;
+    cm2_vec2 max = constraint_data->baked_max;
+
+    // Left edge
+    if (p_pos.x < min.x) particle->position.x = min.x;
+    // Right edge
+    else if (p_pos.x > max.x) particle->position.x = max.x;
+
+    // Top edge
+    if (p_pos.y < min.y) particle->position.y = min.y;
+    // Bottom edge
+    else if (p_pos.y > max.y) particle->position.y = max.y;
+}
+
 Constraint *box_constraint_new(cm2_vec2 min, cm2_vec2 max) {
     BoxConstraint *box_constraint = (BoxConstraint*) malloc(sizeof(BoxConstraint));
     box_constraint->min = min;
     box_constraint->max = max;
 
-    Constraint *constraint = (Constraint*) malloc(sizeof(Constraint));
-    constraint->data = box_constraint;
-    constraint->apply = box_constraint_apply;
-    return constraint;
+    return constraint_new(
+        box_constraint,
+        box_constraint_apply,
+        box_constraint_bake,
+        box_constraint_apply_baked
+    );
 }
 
 Constraint *box_constraint_fit_grid(ParticleGrid *grid) {
@@ -9,20 +9,34 @@
 struct Constraint;
 
 typedef void (*ApplyConstraintFn)(struct Constraint *constraint, Particle *particle);
+typedef void (*BakeConstraintFn)(struct Constraint *constraint, float radius);
 
 struct Constraint {
     void *data;
     ApplyConstraintFn apply;
+
+    // Specialization for particles that all have the same radius. `bake` precomputes everything
+    // that only depends on the radius, after which `apply_baked` can be used for particles with
+    // exactly that radius. Both are NULL if the constraint has no specialization.
+    BakeConstraintFn bake;
+    ApplyConstraintFn apply_baked;
+    bool is_baked;
+    float baked_radius;
 };
 
 typedef struct Constraint Constraint;
 
+Constraint *constraint_new(void *data, ApplyConstraintFn apply, BakeConstraintFn bake, ApplyConstraintFn apply_baked);
+void constraint_bake_uniform_radius(Constraint *constraint, float radius);
 void constraint_delete(Constraint *constraint);
 
 
 typedef struct {
     cm2_vec2 center;
     float radius;
+
+    // Baked: `radius` minus the particle radius
+    float baked_radius_diff;
 } CircularConstraint;
 
 Constraint *circular_constraint_new(cm2_vec2 center, float radius);
@@ -31,6 +45,10 @@ Constraint *circular_constraint_new(cm2_vec2 center, float radius);
 typedef struct {
     cm2_vec2 min;
     cm2_vec2 max;
+
+    // Baked: bounds for the center of a particle
+    cm2_vec2 baked_min;
+    cm2_vec2 baked_max;
 } BoxConstraint;
 
 Constraint *box_constraint_new(cm2_vec2 min, cm2_vec2 max);
@@ -1,72 +1,173 @@
 #include "data.h"
 
+#include "../opengl/render_state.h"
+
+#include <stddef.h>
 #include <stdlib.h>
-#include <stdbool.h>
 
 #include "../../thirdparty/c_log.h"
 
-ParticleGpuDataStagingBuffer particle_gpu_data_staging_buffer_new() {
-    ParticleGpuDataStagingBuffer staging_buffer;
-    size_t capacity = PARTICLE_GPU_DATA_STAGING_BUFFER_INITIAL_CAP;
-    staging_buffer.position_and_radius_buffer = (cm2_vec4 *) malloc(sizeof(cm2_vec4) * capacity);
-    staging_buffer.color_buffer = (cm2_vec4 *) malloc(sizeof(cm2_vec4) * capacity);
-    staging_buffer.capacity = capacity;
+static uint8_t particle_instance_color_channel(float value) {
+    if (value <= 0.0) return 0;
+    if (value >= 1.0) return 255;
+    return (uint8_t) (value * 255.0 + 0.5);
+}
 
-    c_log(C_LOG_SEVERITY_DEBUG, "Staging buffer allocation: size = %lu", capacity);
+ParticleInstanceColor particle_instance_color_new(cm2_vec4 color) {
+    ParticleInstanceColor instance_color;
+    instance_color.r = particle_instance_color_channel(color.x);
+    instance_color.g = particle_instance_color_channel(color.y);
+    instance_color.b = particle_instance_color_channel(color.z);
+    instance_color.a = particle_instance_color_channel(color.w);
+    return instance_color;
+}
 
-    return staging_buffer;
+ParticleGpuData particle_gpu_data_new() {
+    ParticleGpuData data;
+    data.position_and_radius_buffer = stream_buffer_new(GL_ARRAY_BUFFER);
+    data.color_buffer = stream_buffer_new(GL_ARRAY_BUFFER);
+    data.particle_count = 0;
+    data.color_count = 0;
+    data.thread_count = PARTICLE_GPU_DATA_DEFAULT_THREAD_COUNT;
+    data.fill_time = 0.0;
+    data.fill_pool = NULL;
+    return data;
 }
 
-void particle_gpu_data_staging_buffer_resize(ParticleGpuDataStagingBuffer *staging_buffer, size_t new_cap) {
-    if (new_cap <= staging_buffer->capacity) {
-        // Don't reallocate if the new capacity is less than the current capacity
-        return;
-    }
+static void particle_gpu_data_bind_attribute(
+    StreamBuffer *stream_buffer, GLuint index,
+    GLint size, GLenum type, GLboolean normalized, GLsizei stride, size_t offset
+) {
+    glVertexAttribPointer(index, size, type, normalized, stride, (void *) (stream_buffer_offset(stream_buffer) + offset));
+    glEnableVertexAttribArray(index);
+    glVertexAttribDivisor(index, 1);
+    render_state_count_calls(3);
+}
+
+void particle_gpu_data_bind_attributes(ParticleGpuData *particle_gpu_data) {
+    // The data moves between the regions of the buffers (and the buffers themselves are replaced when they grow),
+    // so the attribute pointers are set again before every draw
+    StreamBuffer *position_buffer = &particle_gpu_data->position_and_radius_buffer;
+    buffer_bind(&position_buffer->buffer);
+    particle_gpu_data_bind_attribute(
+        position_buffer, 1, 2, GL_FLOAT, GL_FALSE,
+        sizeof(ParticleInstancePosition), offsetof(ParticleInstancePosition, x)
+    );
+    particle_gpu_data_bind_attribute(
+        position_buffer, 3, 1, GL_HALF_FLOAT, GL_FALSE,
+        sizeof(ParticleInstancePosition), offsetof(ParticleInstancePosition, radius)
+    );
+
+    StreamBuffer *color_buffer = &particle_gpu_data->color_buffer;
+    buffer_bind(&color_buffer->buffer);
+    particle_gpu_data_bind_attribute(
+        color_buffer, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+        sizeof(ParticleInstanceColor), 0
+    );
+}
 
-    c_log(C_LOG_SEVERITY_DEBUG, "Staging buffer reallocation: size = %lu", new_cap);
+typedef struct {
+    ParticleFillPool *pool;
+    size_t section;
+} ParticleFillWorkerArgs;
+
+static void *particle_fill_pool_run(void *argvp) {
+    ParticleFillWorkerArgs args = *(ParticleFillWorkerArgs *) argvp;
+    free(argvp);
+
+    ParticleFillPool *pool = args.pool;
+    for (;;) {
+        pthread_barrier_wait(&pool->start);
+        if (pool->stopping) {
+            break;
+        }
+
+        if (args.section < pool->section_count) {
+            pool->fill(pool->fill_data, args.section, pool->section_count);
+        }
+        pthread_barrier_wait(&pool->done);
+    }
 
-    staging_buffer->position_and_radius_buffer = (cm2_vec4 *)
-        realloc(staging_buffer->position_and_radius_buffer, sizeof(cm2_vec4) * new_cap);
-    staging_buffer->color_buffer = (cm2_vec4 *)
-        realloc(staging_buffer->color_buffer, sizeof(cm2_vec4) * new_cap);
-    staging_buffer->capacity = new_cap;
+    return NULL;
 }
 
-void particle_gpu_data_staging_buffer_delete(ParticleGpuDataStagingBuffer *staging_buffer) {
-    free(staging_buffer->position_and_radius_buffer);
-    free(staging_buffer->color_buffer);
+// Starts `threads_len` workers, which fill the sections after the first one
+static ParticleFillPool *particle_fill_pool_new(size_t threads_len) {
+    ParticleFillPool *pool = (ParticleFillPool *) malloc(sizeof(ParticleFillPool));
+    pool->threads = (pthread_t *) malloc(sizeof(pthread_t) * threads_len);
+    pool->threads_len = threads_len;
+    pool->fill = NULL;
+    pool->fill_data = NULL;
+    pool->section_count = 0;
+    pool->stopping = false;
+
+    // The calling thread takes part in both barriers
+    pthread_barrier_init(&pool->start, NULL, threads_len + 1);
+    pthread_barrier_init(&pool->done, NULL, threads_len + 1);
+
+    for (size_t i = 0; i < threads_len; ++i) {
+        ParticleFillWorkerArgs *args = (ParticleFillWorkerArgs *) malloc(sizeof(ParticleFillWorkerArgs));
+        args->pool = pool;
+        args->section = i + 1;
+        if (pthread_create(&pool->threads[i], NULL, particle_fill_pool_run, args) != 0) {
+            c_log(C_LOG_SEVERITY_ERROR, "Failed to create fill thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return pool;
 }
 
-ParticleGpuData particle_gpu_data_new() {
-    ParticleGpuData data;
+static void particle_fill_pool_delete(ParticleFillPool *pool) {
+    pool->stopping = true;
+    pthread_barrier_wait(&pool->start);
+    for (size_t i = 0; i < pool->threads_len; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_barrier_destroy(&pool->start);
+    pthread_barrier_destroy(&pool->done);
+    free(pool->threads);
+    free(pool);
+}
 
-    // Set vertex attribute pointer for position and radius buffer
-    data.position_and_radius_buffer = buffer_new(GL_ARRAY_BUFFER);
-    buffer_bind(&data.position_and_radius_buffer);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
-    glEnableVertexAttribArray(1);
-    glVertexAttribDivisor(1, 1);
+void particle_gpu_data_fill(ParticleGpuData *particle_gpu_data, size_t section_count, ParticleFillFunction fill, void *data) {
+    if (section_count > 1 && !particle_gpu_data->fill_pool && particle_gpu_data->thread_count > 1) {
+        particle_gpu_data->fill_pool = particle_fill_pool_new(particle_gpu_data->thread_count - 1);
+    }
 
-    // Set vertex attribute pointer for color buffer
-    data.color_buffer = buffer_new(GL_ARRAY_BUFFER);
-    buffer_bind(&data.color_buffer);
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), NULL);
-    glEnableVertexAttribArray(2);
-    glVertexAttribDivisor(2, 1);
+    // Without a pool (or with a smaller one than asked for, if the thread count was raised after it was started),
+    // fill fewer but larger sections
+    ParticleFillPool *pool = particle_gpu_data->fill_pool;
+    size_t max_section_count = pool ? pool->threads_len + 1 : 1;
+    if (section_count > max_section_count) section_count = max_section_count;
+    if (section_count < 1) section_count = 1;
 
-    // Create staging buffer
-    data.staging_buffer = particle_gpu_data_staging_buffer_new();
+    if (section_count == 1) {
+        fill(data, 0, 1);
+        return;
+    }
 
-    return data;
+    // The barriers order the writes to the pool before the workers read them, and the writes of the
+    // workers before this thread continues
+    pool->fill = fill;
+    pool->fill_data = data;
+    pool->section_count = section_count;
+    pthread_barrier_wait(&pool->start);
+    fill(data, 0, section_count);
+    pthread_barrier_wait(&pool->done);
 }
 
-void particle_gpu_data_bind_buffers(ParticleGpuData *particle_gpu_data) {
-    buffer_bind(&particle_gpu_data->position_and_radius_buffer);
-    buffer_bind(&particle_gpu_data->color_buffer);
+void particle_gpu_data_fence(ParticleGpuData *particle_gpu_data) {
+    stream_buffer_fence(&particle_gpu_data->position_and_radius_buffer);
+    stream_buffer_fence(&particle_gpu_data->color_buffer);
 }
 
 void particle_gpu_data_delete(ParticleGpuData *particle_gpu_data) {
-    buffer_delete(&particle_gpu_data->position_and_radius_buffer);
-    buffer_delete(&particle_gpu_data->color_buffer);
-    particle_gpu_data_staging_buffer_delete(&particle_gpu_data->staging_buffer);
+    if (particle_gpu_data->fill_pool) {
+        particle_fill_pool_delete(particle_gpu_data->fill_pool);
+    }
+
+    stream_buffer_delete(&particle_gpu_data->position_and_radius_buffer);
+    stream_buffer_delete(&particle_gpu_data->color_buffer);
 }
@@ -6,31 +6,80 @@
 
 #include "../../thirdparty/c_math2d.h"
 
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
 
-#ifndef PARTICLE_GPU_DATA_STAGING_BUFFER_INITIAL_CAP
-#define PARTICLE_GPU_DATA_STAGING_BUFFER_INITIAL_CAP 16
-#endif /* PARTICLE_GPU_DATA_STAGING_BUFFER_INITIAL_CAP */
+// Number of threads that fill the instance data by default
+#ifndef PARTICLE_GPU_DATA_DEFAULT_THREAD_COUNT
+#define PARTICLE_GPU_DATA_DEFAULT_THREAD_COUNT 4
+#endif /* PARTICLE_GPU_DATA_DEFAULT_THREAD_COUNT */
 
+// Fewer particles than this per thread are filled on the calling thread
+#ifndef PARTICLE_GPU_DATA_MIN_PARTICLES_PER_THREAD
+#define PARTICLE_GPU_DATA_MIN_PARTICLES_PER_THREAD 16384
+#endif /* PARTICLE_GPU_DATA_MIN_PARTICLES_PER_THREAD */
 
+// Position and radius of an instance, 12 bytes. The position stays in full precision, since a half float
+// only resolves half a unit at the size of the window. The radius is a half float.
 typedef struct {
-    cm2_vec4 *position_and_radius_buffer;
-    cm2_vec4 *color_buffer;
-    size_t capacity;
-} ParticleGpuDataStagingBuffer;
+    float x, y;
+    uint16_t radius;
+    uint16_t padding;
+} ParticleInstancePosition;
 
-ParticleGpuDataStagingBuffer particle_gpu_data_staging_buffer_new();
-void particle_gpu_data_staging_buffer_resize(ParticleGpuDataStagingBuffer *staging_buffer, size_t new_cap);
-void particle_gpu_data_staging_buffer_delete(ParticleGpuDataStagingBuffer *staging_buffer);
+// Color of an instance as normalized RGBA8, 4 bytes
+typedef struct {
+    uint8_t r, g, b, a;
+} ParticleInstanceColor;
+
+ParticleInstanceColor particle_instance_color_new(cm2_vec4 color);
+
+// Fills section `section` of `section_count` sections of the instance data
+typedef void (*ParticleFillFunction)(void *data, size_t section, size_t section_count);
+
+// Threads that help filling the instance data. They're started once and wait on a barrier between uploads,
+// so an upload doesn't create any threads. The calling thread always fills the first section itself.
+typedef struct {
+    pthread_t *threads;
+    size_t threads_len;
+
+    // The workers wait on `start` for the next fill and meet the calling thread at `done` when it's written
+    pthread_barrier_t start, done;
+    ParticleFillFunction fill;
+    void *fill_data;
+    size_t section_count;
+    bool stopping;
+} ParticleFillPool;
 
+// Instance data of the particles, streamed to the GPU every frame. The particle list writes
+// directly into the stream buffers, there is no copy on the CPU side in between.
 typedef struct {
-    Buffer position_and_radius_buffer;
-    Buffer color_buffer;
+    StreamBuffer position_and_radius_buffer;
+    StreamBuffer color_buffer;
     int particle_count;
-    ParticleGpuDataStagingBuffer staging_buffer;
+
+    // Number of particles whose color is in the color buffer. Colors never change after a particle is
+    // added, so only the colors of particles at and after this index have to be uploaded. Setting it to 0
+    // uploads all colors again.
+    size_t color_count;
+
+    // The positions are filled by up to `thread_count` threads, `fill_time` is what that took (in milliseconds)
+    // on the last upload. The pool is only started by the first upload that needs more than one thread, and
+    // it's allocated separately, so the data can still be moved around after that.
+    size_t thread_count;
+    float fill_time;
+    ParticleFillPool *fill_pool;
 } ParticleGpuData;
 
 ParticleGpuData particle_gpu_data_new();
-void particle_gpu_data_bind_buffers(ParticleGpuData *particle_gpu_data);
+// Points the instance attributes of the currently bound VAO to the last written data
+void particle_gpu_data_bind_attributes(ParticleGpuData *particle_gpu_data);
+// Runs `fill` for every section, using the fill pool if there is more than one section. Returns once all
+// sections are filled.
+void particle_gpu_data_fill(ParticleGpuData *particle_gpu_data, size_t section_count, ParticleFillFunction fill, void *data);
+// Called after the draws that read the last written data
+void particle_gpu_data_fence(ParticleGpuData *particle_gpu_data);
 void particle_gpu_data_delete(ParticleGpuData *particle_gpu_data);
 
 #endif /* PARTICLE_DATA_H */
@@ -0,0 +1,196 @@
+#include "force_field.h"
+
+#include <float.h>
+#include <stdlib.h>
+
+static ForceField force_field_new(ForceFieldType type, cm2_vec2 center, float strength, float radius) {
+    ForceField field;
+    field.type = type;
+    field.enabled = true;
+    field.center = center;
+    field.acceleration = cm2_vec2_new(0.0, 0.0);
+    field.strength = strength;
+    field.radius = radius;
+    return field;
+}
+
+ForceField force_field_uniform(cm2_vec2 acceleration) {
+    ForceField field = force_field_new(FORCE_FIELD_UNIFORM, cm2_vec2_new(0.0, 0.0), 0.0, 0.0);
+    field.acceleration = acceleration;
+    return field;
+}
+
+ForceField force_field_point(cm2_vec2 center, float strength, float radius) {
+    return force_field_new(FORCE_FIELD_POINT, center, strength, radius);
+}
+
+ForceField force_field_radial(cm2_vec2 center, float strength, float radius) {
+    return force_field_new(FORCE_FIELD_RADIAL, center, strength, radius);
+}
+
+ForceField force_field_vortex(cm2_vec2 center, float strength, float radius) {
+    return force_field_new(FORCE_FIELD_VORTEX, center, strength, radius);
+}
+
+cm2_vec2 force_field_acceleration_at(ForceField *field, cm2_vec2 position) {
+    if (field->type == FORCE_FIELD_UNIFORM) {
+        return field->acceleration;
+    }
+
+    cm2_vec2 to_center = cm2_vec2_sub(field->center, position);
+    float dist_sq = to_center.x * to_center.x + to_center.y * to_center.y;
+    if ((field->radius > 0.0 && dist_sq >= field->radius * field->radius) || dist_sq == 0.0) {
+        return cm2_vec2_new(0.0, 0.0);
+    }
+
+    float dist = sqrtf(dist_sq);
+    cm2_vec2 direction = cm2_vec2_scale(to_center, 1.0 / dist);
+
+    switch (field->type) {
+        case FORCE_FIELD_POINT: {
+            float softened = dist + FORCE_FIELD_POINT_SOFTENING;
+            return cm2_vec2_scale(direction, field->strength / (softened * softened));
+        }
+        case FORCE_FIELD_RADIAL: {
+            float falloff = 1.0 - dist / field->radius;
+            return cm2_vec2_scale(direction, field->strength * falloff);
+        }
+        case FORCE_FIELD_VORTEX: {
+            // Perpendicular to the direction towards the center
+            float falloff = 1.0 - dist / field->radius;
+            cm2_vec2 tangent = cm2_vec2_new(direction.y, -direction.x);
+            return cm2_vec2_scale(tangent, field->strength * falloff);
+        }
+        default:
+            return cm2_vec2_new(0.0, 0.0);
+    }
+}
+
+ForceFields force_fields_new() {
+    ForceFields force_fields;
+    force_fields.fields_len = 0;
+    force_fields.fields_cap = FORCE_FIELDS_INITIAL_CAP;
+    force_fields.fields = (ForceField *) malloc(sizeof(ForceField) * force_fields.fields_cap);
+    force_fields.packed = (ForceFieldsPacked) {0};
+    return force_fields;
+}
+
+size_t force_fields_push(ForceFields *force_fields, ForceField field) {
+    if (force_fields->fields_len >= force_fields->fields_cap) {
+        force_fields->fields_cap *= 2; // Grow buffer capacity exponentially
+        force_fields->fields = (ForceField *)
+            realloc(force_fields->fields, sizeof(ForceField) * force_fields->fields_cap);
+    }
+
+    force_fields->fields[force_fields->fields_len] = field;
+    return force_fields->fields_len++;
+}
+
+cm2_vec2 force_fields_uniform_acceleration(ForceFields *force_fields) {
+    cm2_vec2 acceleration = cm2_vec2_new(0.0, 0.0);
+    for (size_t i = 0; i < force_fields->fields_len; ++i) {
+        ForceField *field = &force_fields->fields[i];
+        if (field->enabled && field->type == FORCE_FIELD_UNIFORM) {
+            acceleration = cm2_vec2_add(acceleration, field->acceleration);
+        }
+    }
+
+    return acceleration;
+}
+
+static void force_fields_packed_reserve(ForceFieldsPacked *packed, size_t capacity) {
+    if (capacity <= packed->data_cap) {
+        return;
+    }
+
+    packed->data_cap = capacity;
+    packed->data = (float *) realloc(packed->data, sizeof(float) * 8 * capacity);
+    packed->center_x = packed->data;
+    packed->center_y = packed->data + capacity;
+    packed->radius_sq = packed->data + 2 * capacity;
+    packed->inv_radius = packed->data + 3 * capacity;
+    packed->point_strength = packed->data + 4 * capacity;
+    packed->falloff_strength = packed->data + 5 * capacity;
+    packed->radial = packed->data + 6 * capacity;
+    packed->tangential = packed->data + 7 * capacity;
+}
+
+ForceFieldsPacked *force_fields_pack(ForceFields *force_fields) {
+    ForceFieldsPacked *packed = &force_fields->packed;
+    force_fields_packed_reserve(packed, force_fields->fields_len);
+
+    packed->len = 0;
+    for (size_t i = 0; i < force_fields->fields_len; ++i) {
+        ForceField *field = &force_fields->fields[i];
+
+        // Uniform fields are added to every particle together with gravity
+        if (!field->enabled || field->type == FORCE_FIELD_UNIFORM) {
+            continue;
+        }
+
+        size_t idx = packed->len;
+        packed->center_x[idx] = field->center.x;
+        packed->center_y[idx] = field->center.y;
+        packed->radius_sq[idx] = field->radius > 0.0 ? field->radius * field->radius : FLT_MAX;
+        packed->inv_radius[idx] = 0.0;
+        packed->point_strength[idx] = 0.0;
+        packed->falloff_strength[idx] = 0.0;
+        packed->radial[idx] = 1.0;
+        packed->tangential[idx] = 0.0;
+
+        switch (field->type) {
+            case FORCE_FIELD_POINT:
+                packed->point_strength[idx] = field->strength;
+                break;
+            case FORCE_FIELD_RADIAL:
+                packed->falloff_strength[idx] = field->strength;
+                packed->inv_radius[idx] = field->radius > 0.0 ? 1.0 / field->radius : 0.0;
+                break;
+            case FORCE_FIELD_VORTEX:
+                packed->falloff_strength[idx] = field->strength;
+                packed->inv_radius[idx] = field->radius > 0.0 ? 1.0 / field->radius : 0.0;
+                packed->radial[idx] = 0.0;
+                packed->tangential[idx] = 1.0;
+                break;
+            default:
+                continue;
+        }
+
+        packed->len++;
+    }
+
+    return packed->len > 0 ? packed : NULL;
+}
+
+cm2_vec2 force_fields_packed_acceleration_at(ForceFieldsPacked *packed, cm2_vec2 position) {
+    float acceleration_x = 0.0, acceleration_y = 0.0;
+    for (size_t i = 0; i < packed->len; ++i) {
+        float to_center_x = packed->center_x[i] - position.x;
+        float to_center_y = packed->center_y[i] - position.y;
+        float dist_sq = to_center_x * to_center_x + to_center_y * to_center_y;
+        float dist = sqrtf(dist_sq);
+
+        // Outside of the radius (or exactly at the center), the direction is zeroed instead of branching
+        bool inside = dist_sq > 0.0 && dist_sq < packed->radius_sq[i];
+        float inv_dist = inside ? 1.0 / dist : 0.0;
+
+        float softened = dist + FORCE_FIELD_POINT_SOFTENING;
+        float magnitude = packed->point_strength[i] / (softened * softened)
+            + packed->falloff_strength[i] * (1.0 - dist * packed->inv_radius[i]);
+
+        // The tangent is perpendicular to the direction towards the center
+        float direction_x = to_center_x * inv_dist;
+        float direction_y = to_center_y * inv_dist;
+        float radial = packed->radial[i] * magnitude;
+        float tangential = packed->tangential[i] * magnitude;
+        acceleration_x += direction_x * radial + direction_y * tangential;
+        acceleration_y += direction_y * radial - direction_x * tangential;
+    }
+
+    return cm2_vec2_new(acceleration_x, acceleration_y);
+}
+
+void force_fields_delete(ForceFields *force_fields) {
+    free(force_fields->fields);
+    free(force_fields->packed.data);
+}
@@ -0,0 +1,87 @@
+#ifndef FORCE_FIELD_H
+#define FORCE_FIELD_H
+
+#include "grid/grid.h"
+#include "list.h"
+#include "particle.h"
+
+#include <stdbool.h>
+
+#ifndef FORCE_FIELDS_INITIAL_CAP
+#define FORCE_FIELDS_INITIAL_CAP 4
+#endif /* FORCE_FIELDS_INITIAL_CAP */
+
+// Distance added to the distance from the center of point fields, so the acceleration stays finite at the center
+#ifndef FORCE_FIELD_POINT_SOFTENING
+#define FORCE_FIELD_POINT_SOFTENING 20.0
+#endif /* FORCE_FIELD_POINT_SOFTENING */
+
+typedef enum {
+    // Same acceleration everywhere (wind)
+    FORCE_FIELD_UNIFORM,
+
+    // Accelerates towards the center with `strength / distance^2`, repels for a negative strength
+    FORCE_FIELD_POINT,
+
+    // Accelerates towards the center with `strength`, falling off linearly to 0 at `radius`
+    FORCE_FIELD_RADIAL,
+
+    // Accelerates around the center (counterclockwise for a positive strength), falling off linearly to 0 at `radius`
+    FORCE_FIELD_VORTEX
+} ForceFieldType;
+
+typedef struct {
+    ForceFieldType type;
+    bool enabled;
+
+    cm2_vec2 center;
+    cm2_vec2 acceleration;
+    float strength;
+
+    // Fields only affect particles closer than `radius` to their center. A radius of 0 means
+    // unlimited (only for point fields, uniform fields are always unlimited).
+    float radius;
+} ForceField;
+
+ForceField force_field_uniform(cm2_vec2 acceleration);
+ForceField force_field_point(cm2_vec2 center, float strength, float radius);
+ForceField force_field_radial(cm2_vec2 center, float strength, float radius);
+ForceField force_field_vortex(cm2_vec2 center, float strength, float radius);
+cm2_vec2 force_field_acceleration_at(ForceField *field, cm2_vec2 position);
+
+// The enabled fields that depend on the particle position, with one array per parameter. Every field is
+// evaluated the same way, so the integration loop can add all of them to a particle without branching
+// on the field type: the magnitude is `point_strength / (distance + softening)^2` plus
+// `falloff_strength * (1 - distance * inv_radius)`, split between the direction to the center (`radial`)
+// and the tangent (`tangential`). Fields don't affect particles at `radius_sq` or further from the center.
+typedef struct {
+    float *center_x, *center_y;
+    float *radius_sq;
+    float *inv_radius;
+    float *point_strength;
+    float *falloff_strength;
+    float *radial, *tangential;
+    size_t len;
+
+    // All arrays are allocated as one block of `data_cap` floats per array
+    float *data;
+    size_t data_cap;
+} ForceFieldsPacked;
+
+typedef struct {
+    ForceField *fields;
+    size_t fields_len, fields_cap;
+    ForceFieldsPacked packed;
+} ForceFields;
+
+ForceFields force_fields_new();
+size_t force_fields_push(ForceFields *force_fields, ForceField field);
+cm2_vec2 force_fields_uniform_acceleration(ForceFields *force_fields);
+// Packs the enabled position dependent fields, called once per sub step before integration.
+// Returns NULL if there are none.
+ForceFieldsPacked *force_fields_pack(ForceFields *force_fields);
+// Sum of the accelerations of all packed fields at `position`
+cm2_vec2 force_fields_packed_acceleration_at(ForceFieldsPacked *packed, cm2_vec2 position);
+void force_fields_delete(ForceFields *force_fields);
+
+#endif /* FORCE_FIELD_H */
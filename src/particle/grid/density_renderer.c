@@ -0,0 +1,105 @@
+#include "density_renderer.h"
+
+#include "../../opengl/render_state.h"
+
+DensityRenderer density_renderer_from_particle_grid(ParticleGrid *grid) {
+    DensityRenderer renderer;
+    renderer.vao = vao_new();
+    renderer.vbo = buffer_new(GL_ARRAY_BUFFER);
+    renderer.ebo = buffer_new(GL_ELEMENT_ARRAY_BUFFER);
+
+    float vertices[] = {
+         1.0f,  1.0f, 0.0f,
+         1.0f, -1.0f, 0.0f,
+        -1.0f, -1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f,
+    };
+
+    unsigned int indices[] = {
+        0, 1, 3,
+        1, 2, 3
+    };
+
+    vao_bind(&renderer.vao);
+
+    // Upload data to vertex buffer object
+    buffer_bind(&renderer.vbo);
+    buffer_upload_data_static(&renderer.vbo, vertices, sizeof(vertices));
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), NULL);
+    glEnableVertexAttribArray(0);
+
+    // Upload data to element buffer object
+    buffer_bind(&renderer.ebo);
+    buffer_upload_data_static(&renderer.ebo, indices, sizeof(indices));
+
+    renderer.grid_width = (float)grid->width;
+    renderer.grid_height = (float)grid->height;
+    renderer.cell_width = grid->cell_width;
+    renderer.cell_height = grid->cell_height;
+
+    // Create the texture with one texel per cell. Linear filtering smooths the density between cells.
+    renderer.texture_width = grid->width;
+    renderer.texture_height = grid->height;
+    glGenTextures(1, &renderer.texture);
+    render_state_bind_texture_2d(renderer.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(
+        GL_TEXTURE_2D, 0, GL_RGBA8,
+        (GLsizei)renderer.texture_width, (GLsizei)renderer.texture_height, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, NULL
+    );
+
+    // Load shader
+    renderer.shader_program = shader_program_load_from_file("shaders/density.vert", "shaders/density.frag");
+
+    return renderer;
+}
+
+bool density_renderer_should_draw(DensityRenderer *density_renderer, float zoom) {
+    float cell_size = density_renderer->cell_width < density_renderer->cell_height
+        ? density_renderer->cell_width
+        : density_renderer->cell_height;
+    return cell_size * zoom < DENSITY_RENDERER_DEFAULT_MAX_CELL_PIXELS;
+}
+
+void density_renderer_upload(DensityRenderer *density_renderer, uint8_t *density) {
+    render_state_bind_texture_2d(density_renderer->texture);
+    glTexSubImage2D(
+        GL_TEXTURE_2D, 0, 0, 0,
+        (GLsizei)density_renderer->texture_width, (GLsizei)density_renderer->texture_height,
+        GL_RGBA, GL_UNSIGNED_BYTE, density
+    );
+    render_state_count_calls(1);
+}
+
+void density_renderer_draw(DensityRenderer *density_renderer) {
+    // The element buffer is part of the VAO state, it was bound when the renderer was created.
+    // Only texture unit 0 is used, which is active by default.
+    vao_bind(&density_renderer->vao);
+    shader_program_use(&density_renderer->shader_program);
+
+    render_state_bind_texture_2d(density_renderer->texture);
+    shader_program_set_int(&density_renderer->shader_program, "density", 0);
+
+    cm2_vec4 grid_scale = cm2_vec4_new(
+        density_renderer->grid_width, density_renderer->grid_height,
+        density_renderer->cell_width, density_renderer->cell_height
+    );
+    shader_program_set_vec4(&density_renderer->shader_program, "grid_scale", grid_scale);
+
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+    render_state_count_calls(1);
+}
+
+void density_renderer_delete(DensityRenderer *density_renderer) {
+    glDeleteTextures(1, &density_renderer->texture);
+    render_state_forget_texture(density_renderer->texture);
+    buffer_delete(&density_renderer->ebo);
+    buffer_delete(&density_renderer->vbo);
+    vao_delete(&density_renderer->vao);
+    shader_program_delete(&density_renderer->shader_program);
+}
@@ -0,0 +1,38 @@
+#ifndef DENSITY_RENDERER_H
+#define DENSITY_RENDERER_H
+
+#include "../../opengl/buffer.h"
+#include "../../opengl/vao.h"
+#include "../../opengl/shader.h"
+
+#include "grid.h"
+
+#include <stdint.h>
+
+// Particles are drawn as the density of the grid cells once a cell covers fewer pixels than this
+#ifndef DENSITY_RENDERER_DEFAULT_MAX_CELL_PIXELS
+#define DENSITY_RENDERER_DEFAULT_MAX_CELL_PIXELS 4.0
+#endif /* DENSITY_RENDERER_DEFAULT_MAX_CELL_PIXELS */
+
+// Level of detail for views that are zoomed out so far that a particle covers about a pixel or less.
+// Instead of the particles, it draws a texture with one texel per grid cell (color and density
+// of the particles in the cell) onto a quad that covers the grid, like the grid renderer.
+typedef struct {
+    Vao vao;
+    Buffer vbo, ebo;
+    GLuint texture;
+    size_t texture_width, texture_height;
+    float grid_width, grid_height;
+    float cell_width, cell_height;
+    ShaderProgram shader_program;
+} DensityRenderer;
+
+DensityRenderer density_renderer_from_particle_grid(ParticleGrid *grid);
+// Whether a cell covers few enough pixels at the given zoom (pixels per world unit) to draw the density
+bool density_renderer_should_draw(DensityRenderer *density_renderer, float zoom);
+// `density` holds RGBA8 texels, see `ParticleSnapshot`
+void density_renderer_upload(DensityRenderer *density_renderer, uint8_t *density);
+void density_renderer_draw(DensityRenderer *density_renderer);
+void density_renderer_delete(DensityRenderer *density_renderer);
+
+#endif /* DENSITY_RENDERER_H */
@@ -10,12 +10,24 @@ ParticleGrid particle_grid_new(size_t width, size_t height, float cell_width, fl
     grid.height = height;
     grid.cell_width = cell_width;
     grid.cell_height = cell_height;
-    grid.cells = (ParticleGridCell*) malloc(sizeof(ParticleGridCell) * (width * height));
 
-    for (size_t i = 0; i < width * height; ++i) {
+    // Round the grid up to full tiles
+    grid.tiles_x = (width  + PARTICLE_GRID_TILE_SIZE - 1) / PARTICLE_GRID_TILE_SIZE;
+    grid.tiles_y = (height + PARTICLE_GRID_TILE_SIZE - 1) / PARTICLE_GRID_TILE_SIZE;
+    grid.cells_len = grid.tiles_x * grid.tiles_y * PARTICLE_GRID_TILE_CELLS;
+    grid.cells = (ParticleGridCell*) malloc(sizeof(ParticleGridCell) * grid.cells_len);
+
+    for (size_t i = 0; i < grid.cells_len; ++i) {
         grid.cells[i] = particle_grid_cell_new();
     }
 
+    // Allocate the occupancy bitmap (rounded up to full words) and the active cell list, which
+    // can at most hold every cell of the grid
+    size_t occupancy_words = (grid.cells_len + 63) / 64;
+    grid.occupancy = (uint64_t*) calloc(occupancy_words, sizeof(uint64_t));
+    grid.active_cells = (size_t*) malloc(sizeof(size_t) * grid.cells_len);
+    grid.active_cells_len = 0;
+
     return grid;
 }
 
@@ -70,22 +82,61 @@ bool particle_grid_is_position_inside_grid(ParticleGrid *grid, size_t cell_x, si
     return cell_x < grid->width && cell_y < grid->height;
 }
 
+size_t particle_grid_cell_index(ParticleGrid *grid, size_t cell_x, size_t cell_y) {
+    // First find the tile containing the cell, then the position of the cell inside of that tile
+    size_t tile_x = cell_x / PARTICLE_GRID_TILE_SIZE;
+    size_t tile_y = cell_y / PARTICLE_GRID_TILE_SIZE;
+    size_t local_x = cell_x % PARTICLE_GRID_TILE_SIZE;
+    size_t local_y = cell_y % PARTICLE_GRID_TILE_SIZE;
+
+    size_t tile_idx = tile_y * grid->tiles_x + tile_x;
+    return tile_idx * PARTICLE_GRID_TILE_CELLS + local_y * PARTICLE_GRID_TILE_SIZE + local_x;
+}
+
+void particle_grid_cell_position(ParticleGrid *grid, size_t cell_idx, size_t *cell_x, size_t *cell_y) {
+    size_t tile_idx = cell_idx / PARTICLE_GRID_TILE_CELLS;
+    size_t local_idx = cell_idx % PARTICLE_GRID_TILE_CELLS;
+
+    *cell_x = (tile_idx % grid->tiles_x) * PARTICLE_GRID_TILE_SIZE + local_idx % PARTICLE_GRID_TILE_SIZE;
+    *cell_y = (tile_idx / grid->tiles_x) * PARTICLE_GRID_TILE_SIZE + local_idx / PARTICLE_GRID_TILE_SIZE;
+}
+
+bool particle_grid_is_cell_occupied(ParticleGrid *grid, size_t cell_x, size_t cell_y) {
+    size_t cell_idx = particle_grid_cell_index(grid, cell_x, cell_y);
+    return (grid->occupancy[cell_idx / 64] >> (cell_idx % 64)) & 1;
+}
+
 ParticleGridCell *particle_grid_cell_at(ParticleGrid *grid, size_t cell_x, size_t cell_y) {
     if (!particle_grid_is_position_inside_grid(grid, cell_x, cell_y)) {
         return NULL;
     }
 
-    return &grid->cells[cell_y * grid->width + cell_x];
+    return &grid->cells[particle_grid_cell_index(grid, cell_x, cell_y)];
 }
 
-bool particle_grid_insert_index_for_particle(ParticleGrid *grid, Particle *particle, ParticleGridCellIdx idx) {
+bool particle_grid_insert_index_for_particle(
+    ParticleGrid *grid,
+    Particle *particle,
+    ParticleGridCellIdx idx,
+    ParticleCollisionFilter filter
+) {
     size_t cell_x, cell_y;
     if (!particle_grid_index_from_position(grid, particle, &cell_x, &cell_y)) {
         return false;
     }
 
-    ParticleGridCell *cell = particle_grid_cell_at(grid, cell_x, cell_y);
-    particle_grid_cell_push(cell, idx);
+    size_t cell_idx = particle_grid_cell_index(grid, cell_x, cell_y);
+    ParticleGridCell *cell = &grid->cells[cell_idx];
+
+    // If this is the first particle in the cell, mark the cell as occupied and remember it,
+    // so that traversal and clearing only have to visit non-empty cells
+    if (cell->indices_len == 0) {
+        grid->occupancy[cell_idx / 64] |= (uint64_t)1 << (cell_idx % 64);
+        grid->active_cells[grid->active_cells_len] = cell_idx;
+        grid->active_cells_len++;
+    }
+
+    particle_grid_cell_push(cell, idx, filter);
 
     return true;
 }
@@ -93,21 +144,47 @@ bool particle_grid_insert_index_for_particle(ParticleGrid *grid, Particle *parti
 void particle_grid_insert_all(ParticleGrid *grid, ParticleList *list) {
     for (ParticleGridCellIdx idx = 0; idx < list->buffer_len; ++idx) {
         Particle *particle = &list->buffer[idx];
-        particle_grid_insert_index_for_particle(grid, particle, idx);
+        particle_grid_insert_index_for_particle(grid, particle, idx, list->filters[idx]);
+    }
+
+    particle_grid_sort_active_cells(grid);
+}
+
+void particle_grid_sort_active_cells(ParticleGrid *grid) {
+    // Rebuild the active cell list from the occupancy bitmap. Since the bitmap is laid out like the cells,
+    // this yields the active cells in storage order, so traversal walks through memory tile by tile instead
+    // of jumping around in the order the particles were inserted.
+    size_t occupancy_words = (grid->cells_len + 63) / 64;
+
+    grid->active_cells_len = 0;
+    for (size_t word_idx = 0; word_idx < occupancy_words; ++word_idx) {
+        uint64_t word = grid->occupancy[word_idx];
+        while (word != 0) {
+            size_t bit = __builtin_ctzll(word);
+            grid->active_cells[grid->active_cells_len] = word_idx * 64 + bit;
+            grid->active_cells_len++;
+
+            // Clear lowest set bit
+            word &= word - 1;
+        }
     }
 }
 
 void particle_grid_clear(ParticleGrid *grid) {
-    for (size_t i = 0; i < grid->width * grid->height; ++i) {
-        ParticleGridCell *cell = &grid->cells[i];
-        particle_grid_cell_clear(cell);
+    // Only the active cells can contain particles, all other cells are already empty
+    for (size_t i = 0; i < grid->active_cells_len; ++i) {
+        size_t cell_idx = grid->active_cells[i];
+        particle_grid_cell_clear(&grid->cells[cell_idx]);
+        grid->occupancy[cell_idx / 64] &= ~((uint64_t)1 << (cell_idx % 64));
     }
+
+    grid->active_cells_len = 0;
 }
 
 void particle_grid_print_basic(ParticleGrid *grid) {
     for (size_t y = 0; y < grid->height; ++y) {
         for (size_t x = 0; x < grid->width; ++x) {
-            ParticleGridCell *cell = &grid->cells[y * grid->width + x];
+            ParticleGridCell *cell = particle_grid_cell_at(grid, x, y);
             if (cell->indices_len == 0) {
                 printf("[  ] ");
             } else {
@@ -121,7 +198,7 @@ void particle_grid_print_basic(ParticleGrid *grid) {
 void particle_grid_print_with_first_particle_pos(ParticleGrid *grid, ParticleList *list) {
     for (size_t y = 0; y < grid->height; ++y) {
         for (size_t x = 0; x < grid->width; ++x) {
-            ParticleGridCell *cell = &grid->cells[y * grid->width + x];
+            ParticleGridCell *cell = particle_grid_cell_at(grid, x, y);
             Particle *particle = NULL;
             if (cell->indices_len > 0) {
                 ParticleGridCellIdx idx = cell->indices[0];
@@ -139,10 +216,12 @@ void particle_grid_print_with_first_particle_pos(ParticleGrid *grid, ParticleLis
 }
 
 void particle_grid_delete(ParticleGrid *grid) {
-    for (size_t i = 0; i < grid->width * grid->height; ++i) {
+    for (size_t i = 0; i < grid->cells_len; ++i) {
         ParticleGridCell *cell = &grid->cells[i];
         particle_grid_cell_delete(cell);
     }
 
     free(grid->cells);
+    free(grid->occupancy);
+    free(grid->active_cells);
 }
@@ -6,11 +6,34 @@
 #include "../particle.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+
+// Cells are stored in square tiles of PARTICLE_GRID_TILE_SIZE x PARTICLE_GRID_TILE_SIZE cells.
+// The cells of a tile are contiguous in memory (row-major inside of the tile), and the tiles themselves
+// are stored row-major. Should be a power of two.
+#ifndef PARTICLE_GRID_TILE_SIZE
+#define PARTICLE_GRID_TILE_SIZE 8
+#endif /* PARTICLE_GRID_TILE_SIZE */
+
+#define PARTICLE_GRID_TILE_CELLS (PARTICLE_GRID_TILE_SIZE * PARTICLE_GRID_TILE_SIZE)
 
 typedef struct {
     ParticleGridCell *cells;
     size_t width, height;
     float cell_width, cell_height;
+
+    // Number of tiles in each direction. The last row/column of tiles might extend past the grid,
+    // the cells in that overhang are allocated but never used.
+    size_t tiles_x, tiles_y;
+    size_t cells_len;
+
+    // One bit per cell, set if the cell contains at least one particle
+    uint64_t *occupancy;
+
+    // Indices of all cells that contain at least one particle, in insertion order
+    // (or in storage order after `particle_grid_sort_active_cells`)
+    size_t *active_cells;
+    size_t active_cells_len;
 } ParticleGrid;
 
 ParticleGrid particle_grid_new(size_t width, size_t height, float cell_width, float cell_height);
@@ -21,9 +44,18 @@ bool particle_grid_index_from_position(
     size_t *cell_x, size_t *cell_y
 );
 bool particle_grid_is_position_inside_grid(ParticleGrid *grid, size_t cell_x, size_t cell_y);
+size_t particle_grid_cell_index(ParticleGrid *grid, size_t cell_x, size_t cell_y);
+void particle_grid_cell_position(ParticleGrid *grid, size_t cell_idx, size_t *cell_x, size_t *cell_y);
+bool particle_grid_is_cell_occupied(ParticleGrid *grid, size_t cell_x, size_t cell_y);
 ParticleGridCell *particle_grid_cell_at(ParticleGrid *grid, size_t cell_x, size_t cell_y);
-bool particle_grid_insert_index_for_particle(ParticleGrid *grid, Particle *particle, ParticleGridCellIdx idx);
+bool particle_grid_insert_index_for_particle(
+    ParticleGrid *grid,
+    Particle *particle,
+    ParticleGridCellIdx idx,
+    ParticleCollisionFilter filter
+);
 void particle_grid_insert_all(ParticleGrid *grid, ParticleList *list);
+void particle_grid_sort_active_cells(ParticleGrid *grid);
 void particle_grid_clear(ParticleGrid *grid);
 void particle_grid_print_basic(ParticleGrid *grid);
 void particle_grid_print_with_first_particle_pos(ParticleGrid *grid, ParticleList *list);
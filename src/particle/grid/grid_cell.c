@@ -7,6 +7,8 @@ ParticleGridCell particle_grid_cell_new() {
     grid_cell.indices_len = 0;
     grid_cell.indices_cap = GRID_CELL_INITIAL_CAP;
     grid_cell.indices = (ParticleGridCellIdx*) malloc(sizeof(ParticleGridCellIdx) * grid_cell.indices_cap);
+    grid_cell.layers = 0;
+    grid_cell.masks = 0;
 
     // Set indices to 0
     for (size_t i = 0; i < grid_cell.indices_cap; ++i) {
@@ -16,7 +18,7 @@ ParticleGridCell particle_grid_cell_new() {
     return grid_cell;
 }
 
-void particle_grid_cell_push(ParticleGridCell *grid_cell, ParticleGridCellIdx idx) {
+void particle_grid_cell_push(ParticleGridCell *grid_cell, ParticleGridCellIdx idx, ParticleCollisionFilter filter) {
     if (grid_cell->indices_len >= grid_cell->indices_cap) {
         // Reallocate the particle buffer
         grid_cell->indices_cap *= 2; // Let it grow (exponentially)
@@ -27,6 +29,10 @@ void particle_grid_cell_push(ParticleGridCell *grid_cell, ParticleGridCellIdx id
     // Write the particle at the last free position and increment length
     grid_cell->indices[grid_cell->indices_len] = idx;
     grid_cell->indices_len++;
+
+    // Aggregate the collision filter of the particle
+    grid_cell->layers |= filter.layer;
+    grid_cell->masks |= filter.mask;
 }
 
 void particle_grid_cell_clear(ParticleGridCell *grid_cell) {
@@ -35,8 +41,10 @@ void particle_grid_cell_clear(ParticleGridCell *grid_cell) {
         grid_cell->indices[i] = 0;
     }
 
-    // Reset grid buffer length
+    // Reset grid buffer length and aggregated collision filter
     grid_cell->indices_len = 0;
+    grid_cell->layers = 0;
+    grid_cell->masks = 0;
 }
 
 void particle_grid_cell_delete(ParticleGridCell *grid_cell) {
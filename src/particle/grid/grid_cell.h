@@ -14,10 +14,13 @@ typedef uint16_t ParticleGridCellIdx;
 typedef struct {
     ParticleGridCellIdx *indices;
     size_t indices_len, indices_cap;
+
+    // Union of the collision layers and masks of all particles in the cell
+    uint32_t layers, masks;
 } ParticleGridCell;
 
 ParticleGridCell particle_grid_cell_new();
-void particle_grid_cell_push(ParticleGridCell *grid_cell, ParticleGridCellIdx idx);
+void particle_grid_cell_push(ParticleGridCell *grid_cell, ParticleGridCellIdx idx, ParticleCollisionFilter filter);
 void particle_grid_cell_clear(ParticleGridCell *grid_cell);
 void particle_grid_cell_delete(ParticleGridCell *grid_cell);
 
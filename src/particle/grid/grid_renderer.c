@@ -1,5 +1,7 @@
 #include "grid_renderer.h"
 
+#include "../../opengl/render_state.h"
+
 GridRenderer grid_renderer_new() {
     GridRenderer renderer;
     renderer.vao = vao_new();
@@ -47,11 +49,10 @@ GridRenderer grid_renderer_from_particle_grid(ParticleGrid *grid) {
 }
 
 void grid_renderer_draw(GridRenderer *grid_renderer) {
-    buffer_bind(&grid_renderer->ebo);
+    // The element buffer is part of the VAO state, it was bound when the renderer was created
     vao_bind(&grid_renderer->vao);
     shader_program_use(&grid_renderer->shader_program);
 
-
     cm2_vec4 grid_scale = cm2_vec4_new(
         grid_renderer->grid_width, grid_renderer->grid_height,
         grid_renderer->cell_width, grid_renderer->cell_height
@@ -59,6 +60,7 @@ void grid_renderer_draw(GridRenderer *grid_renderer) {
     shader_program_set_vec4(&grid_renderer->shader_program, "grid_scale", grid_scale);
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
+    render_state_count_calls(1);
 }
 
 void grid_renderer_delete(GridRenderer *grid_renderer) {
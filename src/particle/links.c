@@ -0,0 +1,266 @@
+#include "links.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "../../thirdparty/c_log.h"
+
+ParticleLinks particle_links_new(size_t *thread_count) {
+    ParticleLinks links;
+    links.links_len = 0;
+    links.links_cap = PARTICLE_LINKS_INITIAL_CAP;
+    links.first = (uint32_t *) malloc(sizeof(uint32_t) * links.links_cap);
+    links.second = (uint32_t *) malloc(sizeof(uint32_t) * links.links_cap);
+    links.rest_length = (float *) malloc(sizeof(float) * links.links_cap);
+    links.stiffness = (float *) malloc(sizeof(float) * links.links_cap);
+
+    links.colors_len = 0;
+    links.color_offsets[0] = 0;
+    links.is_colored = true;
+
+    links.anchors_len = 0;
+    links.anchors_cap = PARTICLE_LINKS_INITIAL_CAP;
+    links.anchors = (ParticleAnchor *) malloc(sizeof(ParticleAnchor) * links.anchors_cap);
+
+    links.thread_count = thread_count;
+    return links;
+}
+
+void particle_links_push(ParticleLinks *links, uint32_t first, uint32_t second, float rest_length, float stiffness) {
+    if (links->links_len >= links->links_cap) {
+        links->links_cap *= 2; // Grow buffer capacity exponentially
+        links->first = (uint32_t *) realloc(links->first, sizeof(uint32_t) * links->links_cap);
+        links->second = (uint32_t *) realloc(links->second, sizeof(uint32_t) * links->links_cap);
+        links->rest_length = (float *) realloc(links->rest_length, sizeof(float) * links->links_cap);
+        links->stiffness = (float *) realloc(links->stiffness, sizeof(float) * links->links_cap);
+    }
+
+    links->first[links->links_len] = first;
+    links->second[links->links_len] = second;
+    links->rest_length[links->links_len] = rest_length;
+    links->stiffness[links->links_len] = stiffness;
+    links->links_len++;
+
+    // The new link has to be colored before the next solve
+    links->is_colored = false;
+}
+
+void particle_links_push_anchor(ParticleLinks *links, uint32_t idx, cm2_vec2 position, float rest_length) {
+    if (links->anchors_len >= links->anchors_cap) {
+        links->anchors_cap *= 2; // Grow buffer capacity exponentially
+        links->anchors = (ParticleAnchor *) realloc(links->anchors, sizeof(ParticleAnchor) * links->anchors_cap);
+    }
+
+    ParticleAnchor anchor;
+    anchor.idx = idx;
+    anchor.position = position;
+    anchor.rest_length = rest_length;
+    links->anchors[links->anchors_len] = anchor;
+    links->anchors_len++;
+}
+
+void particle_links_color(ParticleLinks *links, size_t particle_count) {
+    // Colors already taken by the links of each particle
+    uint64_t *used_colors = (uint64_t *) calloc(particle_count > 0 ? particle_count : 1, sizeof(uint64_t));
+    uint8_t *link_colors = (uint8_t *) malloc(sizeof(uint8_t) * (links->links_len > 0 ? links->links_len : 1));
+    size_t color_counts[PARTICLE_LINKS_MAX_COLORS + 1] = {0};
+
+    // Greedy coloring: every link gets the lowest color that neither of its particles uses yet.
+    // Color PARTICLE_LINKS_MAX_COLORS is the extra group for links that didn't get a color.
+    size_t kept_len = 0;
+    for (size_t i = 0; i < links->links_len; ++i) {
+        uint32_t first = links->first[i], second = links->second[i];
+        if (first >= particle_count || second >= particle_count || first == second) {
+            c_log(C_LOG_SEVERITY_WARNING, "Dropping invalid link between particles %u and %u", first, second);
+            continue;
+        }
+
+        uint64_t free_colors = ~(used_colors[first] | used_colors[second]);
+        size_t color = PARTICLE_LINKS_MAX_COLORS;
+        if (free_colors != 0) {
+            color = __builtin_ctzll(free_colors);
+            if (color < PARTICLE_LINKS_MAX_COLORS) {
+                used_colors[first] |= (uint64_t)1 << color;
+                used_colors[second] |= (uint64_t)1 << color;
+            } else {
+                color = PARTICLE_LINKS_MAX_COLORS;
+            }
+        }
+
+        // Compact the arrays while coloring, so dropped links don't leave gaps
+        links->first[kept_len] = first;
+        links->second[kept_len] = second;
+        links->rest_length[kept_len] = links->rest_length[i];
+        links->stiffness[kept_len] = links->stiffness[i];
+        link_colors[kept_len] = (uint8_t) color;
+        color_counts[color]++;
+        kept_len++;
+    }
+    links->links_len = kept_len;
+
+    // Offsets of each color (up to the highest one in use)
+    links->colors_len = 0;
+    links->color_offsets[0] = 0;
+    for (size_t color = 0; color <= PARTICLE_LINKS_MAX_COLORS; ++color) {
+        links->color_offsets[color + 1] = links->color_offsets[color] + color_counts[color];
+        if (color_counts[color] > 0) {
+            links->colors_len = color + 1;
+        }
+    }
+
+    // Sort the links by color (counting sort into new arrays)
+    uint32_t *first = (uint32_t *) malloc(sizeof(uint32_t) * links->links_cap);
+    uint32_t *second = (uint32_t *) malloc(sizeof(uint32_t) * links->links_cap);
+    float *rest_length = (float *) malloc(sizeof(float) * links->links_cap);
+    float *stiffness = (float *) malloc(sizeof(float) * links->links_cap);
+
+    size_t write_offsets[PARTICLE_LINKS_MAX_COLORS + 1];
+    for (size_t color = 0; color <= PARTICLE_LINKS_MAX_COLORS; ++color) {
+        write_offsets[color] = links->color_offsets[color];
+    }
+
+    for (size_t i = 0; i < links->links_len; ++i) {
+        size_t target = write_offsets[link_colors[i]]++;
+        first[target] = links->first[i];
+        second[target] = links->second[i];
+        rest_length[target] = links->rest_length[i];
+        stiffness[target] = links->stiffness[i];
+    }
+
+    free(links->first);
+    free(links->second);
+    free(links->rest_length);
+    free(links->stiffness);
+    links->first = first;
+    links->second = second;
+    links->rest_length = rest_length;
+    links->stiffness = stiffness;
+
+    free(link_colors);
+    free(used_colors);
+
+    if (color_counts[PARTICLE_LINKS_MAX_COLORS] > 0) {
+        c_log(C_LOG_SEVERITY_WARNING, "%lu links didn't fit into %d colors and are solved serially",
+              color_counts[PARTICLE_LINKS_MAX_COLORS], PARTICLE_LINKS_MAX_COLORS);
+    }
+
+    links->is_colored = true;
+}
+
+static void particle_links_solve_range(ParticleLinks *links, ParticleList *list, size_t start, size_t end) {
+    Particle *particles = list->buffer;
+    for (size_t i = start; i < end; ++i) {
+        Particle *first = &particles[links->first[i]];
+        Particle *second = &particles[links->second[i]];
+
+        cm2_vec2 axis = cm2_vec2_sub(second->position, first->position);
+        float dist_sq = axis.x * axis.x + axis.y * axis.y;
+        if (dist_sq == 0.0) {
+            continue;
+        }
+
+        // Move both particles by half of the error (scaled by the stiffness) along the link
+        float dist = sqrtf(dist_sq);
+        float error = (dist - links->rest_length[i]) / dist;
+        cm2_vec2 correction = cm2_vec2_scale(axis, 0.5 * links->stiffness[i] * error);
+
+        first->position = cm2_vec2_add(first->position, correction);
+        second->position = cm2_vec2_sub(second->position, correction);
+    }
+}
+
+typedef struct {
+    ParticleLinks *links;
+    ParticleList *list;
+    size_t thread_idx, thread_count;
+    pthread_barrier_t *barrier;
+} LinkSolverThreadArgs;
+
+void *particle_links_solve_thread(void *argvp) {
+    LinkSolverThreadArgs *args = argvp;
+    ParticleLinks *links = args->links;
+
+    for (size_t color = 0; color < links->colors_len; ++color) {
+        size_t start = links->color_offsets[color];
+        size_t end = links->color_offsets[color + 1];
+
+        if (color == PARTICLE_LINKS_MAX_COLORS) {
+            // The extra group may contain links that share particles, only the first thread solves it
+            if (args->thread_idx == 0) {
+                particle_links_solve_range(links, args->list, start, end);
+            }
+        } else {
+            // Every thread gets an even share of the links of this color
+            size_t len = end - start;
+            size_t thread_start = start + len * args->thread_idx / args->thread_count;
+            size_t thread_end = start + len * (args->thread_idx + 1) / args->thread_count;
+            particle_links_solve_range(links, args->list, thread_start, thread_end);
+        }
+
+        // A color has to be done on all threads before the next one can start
+        pthread_barrier_wait(args->barrier);
+    }
+
+    return NULL;
+}
+
+void particle_links_solve(ParticleLinks *links, ParticleList *list) {
+    if (!links->is_colored) {
+        particle_links_color(links, list->buffer_len);
+    }
+
+    // Only use as many threads as have enough work to make up for starting them
+    size_t thread_count = links->links_len / PARTICLE_LINKS_MIN_LINKS_PER_THREAD;
+    size_t max_thread_count = links->thread_count ? *links->thread_count : 1;
+    if (thread_count > max_thread_count) thread_count = max_thread_count;
+
+    if (thread_count <= 1) {
+        particle_links_solve_range(links, list, 0, links->links_len);
+    } else {
+        pthread_barrier_t barrier;
+        pthread_barrier_init(&barrier, NULL, thread_count);
+
+        LinkSolverThreadArgs args[thread_count];
+        pthread_t thread_ids[thread_count];
+        for (size_t i = 0; i < thread_count; ++i) {
+            args[i].links = links;
+            args[i].list = list;
+            args[i].thread_idx = i;
+            args[i].thread_count = thread_count;
+            args[i].barrier = &barrier;
+            pthread_create(&thread_ids[i], NULL, particle_links_solve_thread, &args[i]);
+        }
+
+        for (size_t i = 0; i < thread_count; ++i) {
+            pthread_join(thread_ids[i], NULL);
+        }
+
+        pthread_barrier_destroy(&barrier);
+    }
+
+    // Anchors are few, solve them serially. The anchor point doesn't move, so the particle receives the whole correction.
+    for (size_t i = 0; i < links->anchors_len; ++i) {
+        ParticleAnchor *anchor = &links->anchors[i];
+        if (anchor->idx >= list->buffer_len) {
+            continue;
+        }
+
+        Particle *particle = &list->buffer[anchor->idx];
+        cm2_vec2 axis = cm2_vec2_sub(particle->position, anchor->position);
+        float dist_sq = axis.x * axis.x + axis.y * axis.y;
+        if (dist_sq == 0.0) {
+            continue;
+        }
+
+        float dist = sqrtf(dist_sq);
+        particle->position = cm2_vec2_sub(particle->position, cm2_vec2_scale(axis, (dist - anchor->rest_length) / dist));
+    }
+}
+
+void particle_links_delete(ParticleLinks *links) {
+    free(links->first);
+    free(links->second);
+    free(links->rest_length);
+    free(links->stiffness);
+    free(links->anchors);
+}
@@ -0,0 +1,61 @@
+#ifndef PARTICLE_LINKS_H
+#define PARTICLE_LINKS_H
+
+#include "list.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef PARTICLE_LINKS_INITIAL_CAP
+#define PARTICLE_LINKS_INITIAL_CAP 16
+#endif /* PARTICLE_LINKS_INITIAL_CAP */
+
+// Number of colors the links can be split into. Colors are tracked per particle in a 64 bit mask.
+// Links that don't fit into any color are put into an extra group that is solved by a single thread.
+#ifndef PARTICLE_LINKS_MAX_COLORS
+#define PARTICLE_LINKS_MAX_COLORS 64
+#endif /* PARTICLE_LINKS_MAX_COLORS */
+
+// Colors with fewer links than this per thread are solved on the calling thread
+#ifndef PARTICLE_LINKS_MIN_LINKS_PER_THREAD
+#define PARTICLE_LINKS_MIN_LINKS_PER_THREAD 2048
+#endif /* PARTICLE_LINKS_MIN_LINKS_PER_THREAD */
+
+// Keeps a particle at a fixed distance from a point in the world (e.g. the end of a rope)
+typedef struct {
+    uint32_t idx;
+    cm2_vec2 position;
+    float rest_length;
+} ParticleAnchor;
+
+// Distance constraints between pairs of particles, stored as one array per attribute.
+//
+// The links are colored so that no two links of the same color share a particle. Links of one color
+// can then be solved in parallel without write conflicts. After coloring, the arrays are sorted by color
+// and the links of color `c` are `[color_offsets[c], color_offsets[c + 1])`.
+typedef struct {
+    uint32_t *first, *second;
+    float *rest_length;
+    float *stiffness;
+    size_t links_len, links_cap;
+
+    size_t color_offsets[PARTICLE_LINKS_MAX_COLORS + 2];
+    size_t colors_len;
+    bool is_colored;
+
+    ParticleAnchor *anchors;
+    size_t anchors_len, anchors_cap;
+
+    // Largest number of threads the links are solved on. This points to the section count of the solver, so that
+    // changes made to it (e.g. by the governor) apply to the links too. If NULL, the links are solved serially.
+    size_t *thread_count;
+} ParticleLinks;
+
+ParticleLinks particle_links_new(size_t *thread_count);
+void particle_links_push(ParticleLinks *links, uint32_t first, uint32_t second, float rest_length, float stiffness);
+void particle_links_push_anchor(ParticleLinks *links, uint32_t idx, cm2_vec2 position, float rest_length);
+void particle_links_color(ParticleLinks *links, size_t particle_count);
+void particle_links_solve(ParticleLinks *links, ParticleList *list);
+void particle_links_delete(ParticleLinks *links);
+
+#endif /* PARTICLE_LINKS_H */
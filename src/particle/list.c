@@ -2,12 +2,20 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "../util/math.h"
 
 ParticleList particle_list_new() {
     ParticleList list;
     list.buffer_len = 0;
     list.buffer_cap = PARTICLE_LIST_INITIAL_CAP;
     list.buffer = (Particle *) malloc(sizeof(Particle) * list.buffer_cap);
+    list.filters = (ParticleCollisionFilter *) malloc(sizeof(ParticleCollisionFilter) * list.buffer_cap);
+    list.previous_positions = (cm2_vec2 *) malloc(sizeof(cm2_vec2) * list.buffer_cap);
+    list.has_uniform_radius = false;
+    list.uniform_radius = 0.0;
     return list;
 }
 
@@ -16,47 +24,175 @@ bool particle_list_has_to_grow(ParticleList *particle_list) {
 }
 
 void particle_list_push(ParticleList *particle_list, Particle particle) {
+    particle_list_push_with_filter(particle_list, particle, particle_collision_filter_default());
+}
+
+void particle_list_push_with_filter(ParticleList *particle_list, Particle particle, ParticleCollisionFilter filter) {
     if (particle_list_has_to_grow(particle_list)) {
         particle_list->buffer_cap *= 2; // Grow buffer capacity exponentially
         particle_list->buffer = (Particle *)
             realloc(particle_list->buffer, sizeof(Particle) * particle_list->buffer_cap);
+        particle_list->filters = (ParticleCollisionFilter *)
+            realloc(particle_list->filters, sizeof(ParticleCollisionFilter) * particle_list->buffer_cap);
+        particle_list->previous_positions = (cm2_vec2 *)
+            realloc(particle_list->previous_positions, sizeof(cm2_vec2) * particle_list->buffer_cap);
+    }
+
+    // The first particle determines the radius, every particle with a different radius
+    // makes the list non-uniform for good
+    if (particle_list->buffer_len == 0) {
+        particle_list->has_uniform_radius = true;
+        particle_list->uniform_radius = particle.radius;
+    } else if (particle.radius != particle_list->uniform_radius) {
+        particle_list->has_uniform_radius = false;
     }
 
     particle_list->buffer[particle_list->buffer_len] = particle;
+    particle_list->filters[particle_list->buffer_len] = filter;
+    particle_list->previous_positions[particle_list->buffer_len] = particle.position;
     particle_list->buffer_len += 1;
 }
 
-void particle_list_upload(ParticleList *particle_list, ParticleGpuData *gpu_data) {
-    ParticleGpuDataStagingBuffer *staging_buffer = &gpu_data->staging_buffer;
-    particle_gpu_data_staging_buffer_resize(staging_buffer, particle_list->buffer_cap);
+void particle_list_reserve(ParticleList *particle_list, size_t capacity) {
+    if (particle_list->buffer_cap >= capacity) {
+        return;
+    }
+
+    particle_list->buffer_cap = capacity;
+    particle_list->buffer = (Particle *)
+        realloc(particle_list->buffer, sizeof(Particle) * particle_list->buffer_cap);
+    particle_list->filters = (ParticleCollisionFilter *)
+        realloc(particle_list->filters, sizeof(ParticleCollisionFilter) * particle_list->buffer_cap);
+    particle_list->previous_positions = (cm2_vec2 *)
+        realloc(particle_list->previous_positions, sizeof(cm2_vec2) * particle_list->buffer_cap);
+}
+
+void particle_list_clear(ParticleList *particle_list) {
+    particle_list->buffer_len = 0;
+    particle_list->has_uniform_radius = false;
+    particle_list->uniform_radius = 0.0;
+}
 
-    // Copy data from the particle list to the staging buffer
-    for (int i = 0; i < particle_list->buffer_len; ++i)  {
-        Particle *particle = &particle_list->buffer[i];
-        staging_buffer->position_and_radius_buffer[i] =
-            cm2_vec4_new(particle->position.x, particle->position.y, 0.0, particle->radius);
-        staging_buffer->color_buffer[i] = particle->color;
+void particle_list_store_previous_positions(ParticleList *particle_list) {
+    for (size_t i = 0; i < particle_list->buffer_len; ++i) {
+        particle_list->previous_positions[i] = particle_list->buffer[i].position;
     }
+}
+
+void particle_list_copy(ParticleList *destination, ParticleList *source) {
+    particle_list_reserve(destination, source->buffer_cap);
 
-    // Upload position/radius and color data to the GPU
-    buffer_bind(&gpu_data->position_and_radius_buffer);
-    buffer_upload_data_static(
-        &gpu_data->position_and_radius_buffer,
-        staging_buffer->position_and_radius_buffer,
-        sizeof(cm2_vec4) * particle_list->buffer_len
-    );
+    destination->buffer_len = source->buffer_len;
+    memcpy(destination->buffer, source->buffer, sizeof(Particle) * source->buffer_len);
+    memcpy(destination->filters, source->filters, sizeof(ParticleCollisionFilter) * source->buffer_len);
+    memcpy(destination->previous_positions, source->previous_positions, sizeof(cm2_vec2) * source->buffer_len);
+    destination->has_uniform_radius = source->has_uniform_radius;
+    destination->uniform_radius = source->uniform_radius;
+}
 
-    buffer_bind(&gpu_data->color_buffer);
-    buffer_upload_data_static(
-        &gpu_data->color_buffer,
-        staging_buffer->color_buffer,
-        sizeof(cm2_vec4) * particle_list->buffer_len
-    );
+static void particle_list_upload_colors(ParticleList *particle_list, ParticleGpuData *gpu_data) {
+    StreamBuffer *color_buffer = &gpu_data->color_buffer;
+    size_t count = particle_list->buffer_len;
+
+    // Particles are only ever appended, so the colors before `color_count` are already on the GPU.
+    // Only rewrite everything if the new colors don't fit into the buffer.
+    size_t start = gpu_data->color_count;
+    if (start >= count) {
+        return;
+    }
+
+    size_t color_size = sizeof(ParticleInstanceColor);
+    ParticleInstanceColor *colors;
+    if (start > 0 && stream_buffer_can_write_range(color_buffer, color_size * start, color_size * (count - start))) {
+        colors = stream_buffer_begin_write_range(color_buffer, color_size * start, color_size * (count - start));
+    } else {
+        start = 0;
+        colors = stream_buffer_begin_write(color_buffer, color_size * count);
+    }
+
+    for (size_t i = start; i < count; ++i) {
+        colors[i - start] = particle_instance_color_new(particle_list->buffer[i].color);
+    }
 
-    // Update particle count
+    stream_buffer_end_write(color_buffer);
+    gpu_data->color_count = count;
+}
+
+typedef struct {
+    ParticleList *list;
+    ParticleInstancePosition *instances;
+    size_t count;
+    float alpha;
+} ParticleListFillArgs;
+
+static void particle_list_fill_positions(void *argvp, size_t section, size_t section_count) {
+    ParticleListFillArgs *args = argvp;
+    Particle *buffer = args->list->buffer;
+    cm2_vec2 *previous_positions = args->list->previous_positions;
+    ParticleInstancePosition *instances = args->instances;
+    float alpha = args->alpha;
+
+    size_t start = args->count * section / section_count;
+    size_t end = args->count * (section + 1) / section_count;
+
+    // Converting the radius is the most expensive part, only do it once if all radii are the same
+    bool uniform = args->list->has_uniform_radius;
+    uint16_t uniform_radius = float_to_half(args->list->uniform_radius);
+
+    // The position is interpolated between the position before the last simulation step (alpha = 0)
+    // and the current position (alpha = 1)
+    for (size_t i = start; i < end; ++i) {
+        Particle *particle = &buffer[i];
+        cm2_vec2 previous_position = previous_positions[i];
+
+        ParticleInstancePosition *instance = &instances[i];
+        instance->x = previous_position.x + (particle->position.x - previous_position.x) * alpha;
+        instance->y = previous_position.y + (particle->position.y - previous_position.y) * alpha;
+        instance->radius = uniform ? uniform_radius : float_to_half(particle->radius);
+        instance->padding = 0;
+    }
+}
+
+void particle_list_upload(ParticleList *particle_list, ParticleGpuData *gpu_data, float alpha) {
     gpu_data->particle_count = particle_list->buffer_len;
+    if (particle_list->buffer_len == 0) {
+        gpu_data->fill_time = 0.0;
+        return;
+    }
+
+    // Write straight into the memory of the stream buffer
+    size_t count = particle_list->buffer_len;
+    size_t size = sizeof(ParticleInstancePosition) * count;
+    ParticleInstancePosition *instances = stream_buffer_begin_write(&gpu_data->position_and_radius_buffer, size);
+
+    struct timespec fill_start;
+    clock_gettime(CLOCK_MONOTONIC, &fill_start);
+
+    // Only use as many threads as have enough particles to make up for waking them. The threads only
+    // write to memory, all GL calls stay on this thread.
+    size_t thread_count = count / PARTICLE_GPU_DATA_MIN_PARTICLES_PER_THREAD;
+    if (thread_count > gpu_data->thread_count) thread_count = gpu_data->thread_count;
+    if (thread_count < 1) thread_count = 1;
+
+    ParticleListFillArgs args;
+    args.list = particle_list;
+    args.instances = instances;
+    args.count = count;
+    args.alpha = alpha;
+    particle_gpu_data_fill(gpu_data, thread_count, particle_list_fill_positions, &args);
+
+    struct timespec fill_end;
+    clock_gettime(CLOCK_MONOTONIC, &fill_end);
+    gpu_data->fill_time = time_diff_ms(fill_start, fill_end);
+
+    stream_buffer_end_write(&gpu_data->position_and_radius_buffer);
+
+    // Colors are fixed once a particle is added, only new ones are uploaded
+    particle_list_upload_colors(particle_list, gpu_data);
 }
 
 void particle_list_delete(ParticleList *particle_list) {
     free(particle_list->buffer);
+    free(particle_list->filters);
+    free(particle_list->previous_positions);
 }
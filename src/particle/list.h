@@ -4,6 +4,8 @@
 #include "data.h"
 #include "particle.h"
 
+#include <stdbool.h>
+
 
 #ifndef PARTICLE_LIST_INITIAL_CAP
 #define PARTICLE_LIST_INITIAL_CAP 16
@@ -12,11 +14,31 @@
 typedef struct {
     Particle *buffer;
     size_t buffer_len, buffer_cap;
+
+    // Collision filter of each particle. Kept separately from `buffer`, since the narrow phase
+    // checks the filters of every candidate pair before it touches the particles themselves.
+    ParticleCollisionFilter *filters;
+
+    // Positions of the particles before the last simulation step, used to interpolate
+    // between the last two states when rendering
+    cm2_vec2 *previous_positions;
+
+    // Set if all particles in the list have the same radius (`uniform_radius`).
+    // Solvers use this to pick specialized code paths.
+    bool has_uniform_radius;
+    float uniform_radius;
 } ParticleList;
 
 ParticleList particle_list_new();
 void particle_list_push(ParticleList *particle_list, Particle particle);
-void particle_list_upload(ParticleList *particle_list, ParticleGpuData *gpu_data);
+void particle_list_push_with_filter(ParticleList *particle_list, Particle particle, ParticleCollisionFilter filter);
+// Grows the buffers to hold at least `capacity` particles
+void particle_list_reserve(ParticleList *particle_list, size_t capacity);
+void particle_list_clear(ParticleList *particle_list);
+void particle_list_store_previous_positions(ParticleList *particle_list);
+// Makes `destination` a copy of `source`, reusing the memory of `destination` where possible
+void particle_list_copy(ParticleList *destination, ParticleList *source);
+void particle_list_upload(ParticleList *particle_list, ParticleGpuData *gpu_data, float alpha);
 void particle_list_delete(ParticleList *particle_list);
 
 #endif /* PARTICLE_LIST_H */
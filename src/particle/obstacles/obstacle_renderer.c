@@ -0,0 +1,58 @@
+#include "obstacle_renderer.h"
+
+#include "../../opengl/render_state.h"
+
+#include <stdlib.h>
+
+ObstacleRenderer obstacle_renderer_new() {
+    ObstacleRenderer renderer;
+    renderer.vao = vao_new();
+    renderer.vbo = buffer_new(GL_ARRAY_BUFFER);
+    renderer.vertex_count = 0;
+    renderer.color = cm2_vec4_new(0.8, 0.8, 0.8, 1.0);
+
+    vao_bind(&renderer.vao);
+    buffer_bind(&renderer.vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+    glEnableVertexAttribArray(0);
+
+    // Load shader
+    renderer.shader_program = shader_program_load_from_file("shaders/obstacle.vert", "shaders/obstacle.frag");
+
+    return renderer;
+}
+
+void obstacle_renderer_upload(ObstacleRenderer *obstacle_renderer, Obstacles *obstacles) {
+    // Two vertices per segment, drawn as lines
+    size_t vertex_count = obstacles->segments_len * 2;
+    cm2_vec2 *vertices = (cm2_vec2 *) malloc(sizeof(cm2_vec2) * (vertex_count > 0 ? vertex_count : 1));
+    for (size_t i = 0; i < obstacles->segments_len; ++i) {
+        vertices[i * 2] = obstacles->segments[i].start;
+        vertices[i * 2 + 1] = obstacles->segments[i].end;
+    }
+
+    buffer_bind(&obstacle_renderer->vbo);
+    buffer_upload_data_static(&obstacle_renderer->vbo, vertices, sizeof(cm2_vec2) * vertex_count);
+    obstacle_renderer->vertex_count = vertex_count;
+
+    free(vertices);
+}
+
+void obstacle_renderer_draw(ObstacleRenderer *obstacle_renderer) {
+    if (obstacle_renderer->vertex_count == 0) {
+        return;
+    }
+
+    vao_bind(&obstacle_renderer->vao);
+    shader_program_use(&obstacle_renderer->shader_program);
+    shader_program_set_vec4(&obstacle_renderer->shader_program, "color", obstacle_renderer->color);
+
+    glDrawArrays(GL_LINES, 0, obstacle_renderer->vertex_count);
+    render_state_count_calls(1);
+}
+
+void obstacle_renderer_delete(ObstacleRenderer *obstacle_renderer) {
+    buffer_delete(&obstacle_renderer->vbo);
+    vao_delete(&obstacle_renderer->vao);
+    shader_program_delete(&obstacle_renderer->shader_program);
+}
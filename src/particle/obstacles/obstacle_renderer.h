@@ -0,0 +1,23 @@
+#ifndef OBSTACLE_RENDERER_H
+#define OBSTACLE_RENDERER_H
+
+#include "../../opengl/buffer.h"
+#include "../../opengl/vao.h"
+#include "../../opengl/shader.h"
+
+#include "obstacles.h"
+
+typedef struct {
+    Vao vao;
+    Buffer vbo;
+    size_t vertex_count;
+    cm2_vec4 color;
+    ShaderProgram shader_program;
+} ObstacleRenderer;
+
+ObstacleRenderer obstacle_renderer_new();
+void obstacle_renderer_upload(ObstacleRenderer *obstacle_renderer, Obstacles *obstacles);
+void obstacle_renderer_draw(ObstacleRenderer *obstacle_renderer);
+void obstacle_renderer_delete(ObstacleRenderer *obstacle_renderer);
+
+#endif /* OBSTACLE_RENDERER_H */
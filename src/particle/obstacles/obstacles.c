@@ -0,0 +1,278 @@
+#include "obstacles.h"
+
+#include <stdlib.h>
+
+#include "../../../thirdparty/c_log.h"
+
+Obstacles obstacles_fit_grid(ParticleGrid *grid, float max_particle_radius) {
+    Obstacles obstacles;
+    obstacles.segments_len = 0;
+    obstacles.segments_cap = OBSTACLES_INITIAL_CAP;
+    obstacles.segments = (ObstacleSegment *) malloc(sizeof(ObstacleSegment) * obstacles.segments_cap);
+
+    obstacles.width = grid->width;
+    obstacles.height = grid->height;
+    obstacles.cell_width = grid->cell_width;
+    obstacles.cell_height = grid->cell_height;
+    obstacles.max_particle_radius = max_particle_radius;
+
+    obstacles.cell_offsets = (uint32_t *) calloc(obstacles.width * obstacles.height + 1, sizeof(uint32_t));
+    obstacles.cell_segments = NULL;
+    obstacles.is_baked = true;
+    return obstacles;
+}
+
+void obstacles_push_segment(Obstacles *obstacles, cm2_vec2 start, cm2_vec2 end) {
+    if (obstacles->segments_len >= obstacles->segments_cap) {
+        obstacles->segments_cap *= 2; // Grow buffer capacity exponentially
+        obstacles->segments = (ObstacleSegment *)
+            realloc(obstacles->segments, sizeof(ObstacleSegment) * obstacles->segments_cap);
+    }
+
+    ObstacleSegment segment;
+    segment.start = start;
+    segment.end = end;
+    segment.direction = cm2_vec2_sub(end, start);
+
+    float length_sq = segment.direction.x * segment.direction.x + segment.direction.y * segment.direction.y;
+    segment.inv_length_sq = length_sq > 0.0 ? 1.0 / length_sq : 0.0;
+
+    obstacles->segments[obstacles->segments_len] = segment;
+    obstacles->segments_len++;
+
+    // The cell lists have to be rebuilt before the next query
+    obstacles->is_baked = false;
+}
+
+void obstacles_push_polygon(Obstacles *obstacles, cm2_vec2 *points, size_t points_len) {
+    // Closed loop: the last point is connected to the first one
+    for (size_t i = 0; i < points_len; ++i) {
+        obstacles_push_segment(obstacles, points[i], points[(i + 1) % points_len]);
+    }
+}
+
+static cm2_vec2 obstacle_segment_closest_point(ObstacleSegment *segment, cm2_vec2 point) {
+    cm2_vec2 offset = cm2_vec2_sub(point, segment->start);
+    float t = (offset.x * segment->direction.x + offset.y * segment->direction.y) * segment->inv_length_sq;
+    if (t < 0.0) t = 0.0;
+    if (t > 1.0) t = 1.0;
+
+    return cm2_vec2_add(segment->start, cm2_vec2_scale(segment->direction, t));
+}
+
+static bool obstacles_cell_from_position(Obstacles *obstacles, cm2_vec2 position, size_t *cell_x, size_t *cell_y) {
+    // Same mapping as `particle_grid_index_from_position`: the grid is centered around (0,0), y points down
+    float half_world_width = (obstacles->width * obstacles->cell_width) / 2.;
+    float half_world_height = (obstacles->height * obstacles->cell_height) / 2.;
+
+    float x = floorf((position.x + half_world_width) / obstacles->cell_width);
+    float y = floorf((-position.y + half_world_height) / obstacles->cell_height);
+    if (x < 0.0 || y < 0.0 || x >= (float)obstacles->width || y >= (float)obstacles->height) {
+        return false;
+    }
+
+    *cell_x = (size_t) x;
+    *cell_y = (size_t) y;
+    return true;
+}
+
+// Calls `visit` for every cell that a segment can affect. Used for counting and filling the cell lists.
+static void obstacles_visit_segment_cells(
+    Obstacles *obstacles,
+    ObstacleSegment *segment,
+    uint32_t segment_idx,
+    void (*visit)(Obstacles *obstacles, size_t cell_idx, uint32_t segment_idx)
+) {
+    float half_world_width = (obstacles->width * obstacles->cell_width) / 2.;
+    float half_world_height = (obstacles->height * obstacles->cell_height) / 2.;
+    float margin = obstacles->max_particle_radius;
+
+    // Cell range covered by the bounding box of the segment, grown by the particle radius
+    float min_x = fminf(segment->start.x, segment->end.x) - margin;
+    float max_x = fmaxf(segment->start.x, segment->end.x) + margin;
+    float min_y = fminf(segment->start.y, segment->end.y) - margin;
+    float max_y = fmaxf(segment->start.y, segment->end.y) + margin;
+
+    long first_x = (long) floorf((min_x + half_world_width) / obstacles->cell_width);
+    long last_x = (long) floorf((max_x + half_world_width) / obstacles->cell_width);
+    long first_y = (long) floorf((-max_y + half_world_height) / obstacles->cell_height);
+    long last_y = (long) floorf((-min_y + half_world_height) / obstacles->cell_height);
+
+    if (first_x < 0) first_x = 0;
+    if (first_y < 0) first_y = 0;
+    if (last_x >= (long)obstacles->width) last_x = (long)obstacles->width - 1;
+    if (last_y >= (long)obstacles->height) last_y = (long)obstacles->height - 1;
+
+    // A particle centered anywhere in a cell is at most half a cell diagonal away from the cell center
+    float half_diagonal = 0.5 * sqrtf(
+        obstacles->cell_width * obstacles->cell_width + obstacles->cell_height * obstacles->cell_height
+    );
+    float reach = margin + half_diagonal;
+
+    for (long y = first_y; y <= last_y; ++y) {
+        for (long x = first_x; x <= last_x; ++x) {
+            // Drop cells of the bounding box that the (diagonal) segment doesn't come close to
+            cm2_vec2 center = cm2_vec2_new(
+                ((float)x + 0.5) * obstacles->cell_width - half_world_width,
+                half_world_height - ((float)y + 0.5) * obstacles->cell_height
+            );
+            cm2_vec2 offset = cm2_vec2_sub(center, obstacle_segment_closest_point(segment, center));
+            if (offset.x * offset.x + offset.y * offset.y > reach * reach) {
+                continue;
+            }
+
+            visit(obstacles, (size_t)y * obstacles->width + (size_t)x, segment_idx);
+        }
+    }
+}
+
+static void obstacles_count_cell_segment(Obstacles *obstacles, size_t cell_idx, uint32_t segment_idx) {
+    (void) segment_idx;
+    obstacles->cell_offsets[cell_idx + 1]++;
+}
+
+static void obstacles_fill_cell_segment(Obstacles *obstacles, size_t cell_idx, uint32_t segment_idx) {
+    // `cell_offsets[cell_idx]` is used as the write position while filling and is restored afterwards
+    obstacles->cell_segments[obstacles->cell_offsets[cell_idx]] = segment_idx;
+    obstacles->cell_offsets[cell_idx]++;
+}
+
+void obstacles_bake(Obstacles *obstacles) {
+    size_t cell_count = obstacles->width * obstacles->height;
+
+    // Count the segments of each cell ...
+    for (size_t i = 0; i <= cell_count; ++i) {
+        obstacles->cell_offsets[i] = 0;
+    }
+    for (uint32_t i = 0; i < obstacles->segments_len; ++i) {
+        obstacles_visit_segment_cells(obstacles, &obstacles->segments[i], i, obstacles_count_cell_segment);
+    }
+
+    // ... turn the counts into offsets ...
+    for (size_t i = 0; i < cell_count; ++i) {
+        obstacles->cell_offsets[i + 1] += obstacles->cell_offsets[i];
+    }
+
+    size_t entries = obstacles->cell_offsets[cell_count];
+    obstacles->cell_segments = (uint32_t *) realloc(obstacles->cell_segments, sizeof(uint32_t) * (entries > 0 ? entries : 1));
+
+    // ... and fill the lists. Filling advances every offset to the start of the next cell,
+    // so shift them back by one cell afterwards.
+    for (uint32_t i = 0; i < obstacles->segments_len; ++i) {
+        obstacles_visit_segment_cells(obstacles, &obstacles->segments[i], i, obstacles_fill_cell_segment);
+    }
+    for (size_t i = cell_count; i > 0; --i) {
+        obstacles->cell_offsets[i] = obstacles->cell_offsets[i - 1];
+    }
+    obstacles->cell_offsets[0] = 0;
+
+    obstacles->is_baked = true;
+    c_log(C_LOG_SEVERITY_DEBUG, "Baked %lu obstacle segments into %lu cell entries", obstacles->segments_len, entries);
+}
+
+static float obstacle_cross(cm2_vec2 a, cm2_vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+// If the path from the last position to the position crosses the segment, moves the particle back to the
+// side it came from, touching the segment where the path crossed it. Returns how far the particle was moved.
+static float obstacle_segment_sweep(ObstacleSegment *segment, Particle *particle) {
+    cm2_vec2 path = cm2_vec2_sub(particle->position, particle->last_position);
+    float denom = obstacle_cross(path, segment->direction);
+    if (denom == 0.0 || segment->inv_length_sq == 0.0) {
+        // Moving parallel to the segment (or not at all), the overlap test handles it
+        return 0.0;
+    }
+
+    // Fractions along the path (t) and along the segment (u) where the two lines intersect
+    cm2_vec2 to_start = cm2_vec2_sub(segment->start, particle->last_position);
+    float t = obstacle_cross(to_start, segment->direction) / denom;
+    float u = obstacle_cross(to_start, path) / denom;
+    if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) {
+        return 0.0;
+    }
+
+    // Normal of the segment, pointing to the side of the last position
+    float inv_length = sqrtf(segment->inv_length_sq);
+    cm2_vec2 normal = cm2_vec2_new(-segment->direction.y * inv_length, segment->direction.x * inv_length);
+    cm2_vec2 from_start = cm2_vec2_sub(particle->last_position, segment->start);
+    if (from_start.x * normal.x + from_start.y * normal.y < 0.0) {
+        normal = cm2_vec2_scale(normal, -1.0);
+    }
+
+    cm2_vec2 hit = cm2_vec2_add(particle->last_position, cm2_vec2_scale(path, t));
+    cm2_vec2 corrected = cm2_vec2_add(hit, cm2_vec2_scale(normal, particle->radius));
+    float moved = cm2_vec2_length(cm2_vec2_sub(corrected, particle->position));
+    particle->position = corrected;
+    return moved;
+}
+
+static float obstacles_sweep_cell(Obstacles *obstacles, size_t cell_idx, Particle *particle) {
+    float max_penetration = 0.0;
+    uint32_t start = obstacles->cell_offsets[cell_idx];
+    uint32_t end = obstacles->cell_offsets[cell_idx + 1];
+    for (uint32_t i = start; i < end; ++i) {
+        float moved = obstacle_segment_sweep(&obstacles->segments[obstacles->cell_segments[i]], particle);
+        if (moved > max_penetration) max_penetration = moved;
+    }
+    return max_penetration;
+}
+
+float obstacles_apply(Obstacles *obstacles, Particle *particle, Constraint *constraint) {
+    size_t cell_x, cell_y;
+    if (!obstacles_cell_from_position(obstacles, particle->position, &cell_x, &cell_y)) {
+        return 0.0;
+    }
+    size_t cell_idx = cell_y * obstacles->width + cell_x;
+
+    // A fast particle can pass through a segment within one step without ever overlapping it,
+    // so first test the path it took. The crossing can be in the cell the path started in.
+    float max_penetration = obstacles_sweep_cell(obstacles, cell_idx, particle);
+    size_t last_cell_x, last_cell_y;
+    if (obstacles_cell_from_position(obstacles, particle->last_position, &last_cell_x, &last_cell_y)) {
+        size_t last_cell_idx = last_cell_y * obstacles->width + last_cell_x;
+        if (last_cell_idx != cell_idx) {
+            float moved = obstacles_sweep_cell(obstacles, last_cell_idx, particle);
+            if (moved > max_penetration) max_penetration = moved;
+        }
+    }
+
+    // The sweep can move the particle into another cell
+    if (max_penetration > 0.0) {
+        if (!obstacles_cell_from_position(obstacles, particle->position, &cell_x, &cell_y)) {
+            return max_penetration;
+        }
+        cell_idx = cell_y * obstacles->width + cell_x;
+    }
+
+    uint32_t start = obstacles->cell_offsets[cell_idx];
+    uint32_t end = obstacles->cell_offsets[cell_idx + 1];
+
+    // Push the particle out of every segment it overlaps
+    float radius_sq = particle->radius * particle->radius;
+    for (uint32_t i = start; i < end; ++i) {
+        ObstacleSegment *segment = &obstacles->segments[obstacles->cell_segments[i]];
+        cm2_vec2 offset = cm2_vec2_sub(particle->position, obstacle_segment_closest_point(segment, particle->position));
+
+        float dist_sq = offset.x * offset.x + offset.y * offset.y;
+        if (dist_sq < radius_sq && dist_sq > 0.0) {
+            float dist = sqrtf(dist_sq);
+            float delta = particle->radius - dist;
+            particle->position = cm2_vec2_add(particle->position, cm2_vec2_scale(offset, delta / dist));
+            if (delta > max_penetration) max_penetration = delta;
+        }
+    }
+
+    // Segments close to the edge of the world can push particles out of it
+    if (max_penetration > 0.0 && constraint) {
+        constraint->apply(constraint, particle);
+    }
+
+    return max_penetration;
+}
+
+void obstacles_delete(Obstacles *obstacles) {
+    free(obstacles->segments);
+    free(obstacles->cell_offsets);
+    free(obstacles->cell_segments);
+}
@@ -0,0 +1,55 @@
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include "../constraint.h"
+#include "../grid/grid.h"
+#include "../particle.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef OBSTACLES_INITIAL_CAP
+#define OBSTACLES_INITIAL_CAP 16
+#endif /* OBSTACLES_INITIAL_CAP */
+
+// Line segment that particles can't pass through (from either side)
+typedef struct {
+    cm2_vec2 start, end;
+
+    // Precomputed for the closest point query: `end - start` and 1 / |end - start|^2
+    cm2_vec2 direction;
+    float inv_length_sq;
+} ObstacleSegment;
+
+// Static collision geometry made of line segments, for funnels, pegboards and the like.
+//
+// The segments are baked into a grid with the same dimensions as the particle grid: every cell lists
+// the segments that a particle (with a radius up to `max_particle_radius`) centered in that cell can touch.
+// The lists are stored back to back in `cell_segments`, the segments of cell `i` are
+// `cell_segments[cell_offsets[i] .. cell_offsets[i + 1]]` (cells are row-major).
+typedef struct {
+    ObstacleSegment *segments;
+    size_t segments_len, segments_cap;
+
+    size_t width, height;
+    float cell_width, cell_height;
+    float max_particle_radius;
+
+    uint32_t *cell_offsets;
+    uint32_t *cell_segments;
+    bool is_baked;
+} Obstacles;
+
+Obstacles obstacles_fit_grid(ParticleGrid *grid, float max_particle_radius);
+void obstacles_push_segment(Obstacles *obstacles, cm2_vec2 start, cm2_vec2 end);
+void obstacles_push_polygon(Obstacles *obstacles, cm2_vec2 *points, size_t points_len);
+void obstacles_bake(Obstacles *obstacles);
+// Moves the particle back if its path since the last step crossed a segment, then pushes it out of the
+// segments baked into its cell, and returns the deepest penetration it resolved. The path is tested against
+// the segments of the cells it starts and ends in, so it can be at most about a cell long (speculative
+// contacts keep it shorter). If the particle was moved, `constraint` (optional) is applied again, so
+// obstacles can't push particles out of the world.
+float obstacles_apply(Obstacles *obstacles, Particle *particle, Constraint *constraint);
+void obstacles_delete(Obstacles *obstacles);
+
+#endif /* OBSTACLES_H */
@@ -11,8 +11,20 @@ Particle particle_new(float x, float y, float radius, float r, float g, float b,
     return particle;
 }
 
-void particle_update_position(Particle *particle, float dt) {
-    cm2_vec2 velocity = cm2_vec2_sub(particle->position, particle->last_position);
+ParticleCollisionFilter particle_collision_filter_new(uint32_t layer, uint32_t mask) {
+    ParticleCollisionFilter filter;
+    filter.layer = layer;
+    filter.mask = mask;
+    return filter;
+}
+
+ParticleCollisionFilter particle_collision_filter_default() {
+    return particle_collision_filter_new(PARTICLE_LAYER_DEFAULT, PARTICLE_LAYER_DEFAULT);
+}
+
+void particle_update_position(Particle *particle, float dt, float velocity_scale) {
+    // The implicit velocity covers the previous step, scale it to the length of this one (time-corrected Verlet)
+    cm2_vec2 velocity = cm2_vec2_scale(cm2_vec2_sub(particle->position, particle->last_position), velocity_scale);
     particle->last_position = particle->position;
 
     cm2_vec2 offset = cm2_vec2_add(velocity, cm2_vec2_scale(particle->acceleration, dt * dt));
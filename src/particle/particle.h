@@ -3,6 +3,17 @@
 
 #include "../../thirdparty/c_math2d.h"
 
+#include <stdint.h>
+
+// Collision layers: particle A is pushed out of particle B only if A's mask contains B's layer.
+// By default, particles only react to particles on the default layer. A population with mask = 0 isn't
+// pushed by anything, but it still pushes every particle whose mask contains its layer. To add one that
+// doesn't collide at all, also put it on a layer that's outside everyone else's mask. Populations on
+// another layer can also only react to, but not push, default particles.
+#define PARTICLE_LAYER_DEFAULT ((uint32_t)1 << 0)
+#define PARTICLE_MASK_NONE     ((uint32_t)0)
+#define PARTICLE_MASK_ALL      ((uint32_t)0xFFFFFFFF)
+
 typedef struct {
     cm2_vec2 position;
     cm2_vec2 last_position;
@@ -12,8 +23,17 @@ typedef struct {
     cm2_vec4 color;
 } Particle;
 
+typedef struct {
+    uint32_t layer;
+    uint32_t mask;
+} ParticleCollisionFilter;
+
+ParticleCollisionFilter particle_collision_filter_new(uint32_t layer, uint32_t mask);
+ParticleCollisionFilter particle_collision_filter_default();
+
 Particle particle_new(float x, float y, float radius, float r, float g, float b, float a);
-void particle_update_position(Particle *particle, float dt);
+// `velocity_scale` is the ratio of `dt` to the length of the previous step (1 for a constant step length)
+void particle_update_position(Particle *particle, float dt, float velocity_scale);
 void particle_accelerate(Particle *particle, cm2_vec2 acc);
 
 #endif /* PARTICLE_H */
@@ -1,5 +1,6 @@
 #include "renderer.h"
 
+#include "../opengl/render_state.h"
 #include "../util/io.h"
 
 #include "../../thirdparty/c_log.h"
@@ -48,29 +49,63 @@ ParticleRenderer particle_renderer_new() {
     renderer.particle_mesh = particle_mesh_new();
     renderer.shader_program = shader_program_load_from_file("shaders/particle.vert", "shaders/particle.frag");
 
-    // Initialize GPU data
+    // Initialize GPU data (the instance attributes are pointed to it whenever it is drawn)
     renderer.gpu_data = particle_gpu_data_new();
 
+    renderer.static_particle_mesh = particle_mesh_new();
+    renderer.static_gpu_data = particle_gpu_data_new();
+    renderer.partial = false;
+
     return renderer;
 }
 
-void particle_renderer_upload_from_list(ParticleRenderer *particle_renderer, ParticleList *particle_list) {
-    particle_list_upload(particle_list, &particle_renderer->gpu_data);
+void particle_renderer_upload_from_list(ParticleRenderer *particle_renderer, ParticleList *particle_list, float alpha, bool partial) {
+    // Colors are only appended as long as the list keeps its order. Partial lists (and the first complete
+    // one after them) have all their colors uploaded.
+    if (partial || particle_renderer->partial) {
+        particle_renderer->gpu_data.color_count = 0;
+    }
+    particle_renderer->partial = partial;
+
+    particle_list_upload(particle_list, &particle_renderer->gpu_data, alpha);
 }
 
-void particle_renderer_draw(ParticleRenderer *particle_renderer) {
-    particle_gpu_data_bind_buffers(&particle_renderer->gpu_data);
+void particle_renderer_upload_static(ParticleRenderer *particle_renderer, ParticleList *static_list) {
+    // Static particles never move, so they only have to be uploaded again if particles were added
+    if ((size_t) particle_renderer->static_gpu_data.particle_count == static_list->buffer_len) {
+        return;
+    }
+
+    particle_list_upload(static_list, &particle_renderer->static_gpu_data, 1.0);
+}
+
+static void particle_renderer_draw_instances(ParticleRenderer *particle_renderer, ParticleMesh *mesh, ParticleGpuData *gpu_data) {
+    if (gpu_data->particle_count == 0) {
+        return;
+    }
 
-    buffer_bind(&particle_renderer->particle_mesh.ebo);
-    vao_bind(&particle_renderer->particle_mesh.vao);
+    // The element buffer is part of the VAO state, it was bound when the mesh was created
+    vao_bind(&mesh->vao);
+    particle_gpu_data_bind_attributes(gpu_data);
     shader_program_use(&particle_renderer->shader_program);
 
-    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0,
-            particle_renderer->gpu_data.particle_count);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, gpu_data->particle_count);
+    render_state_count_calls(1);
+
+    // The GPU reads the instance data until this draw is done
+    particle_gpu_data_fence(gpu_data);
+}
+
+void particle_renderer_draw(ParticleRenderer *particle_renderer) {
+    particle_renderer_draw_instances(particle_renderer, &particle_renderer->static_particle_mesh, &particle_renderer->static_gpu_data);
+    particle_renderer_draw_instances(particle_renderer, &particle_renderer->particle_mesh, &particle_renderer->gpu_data);
 }
 
 void particle_renderer_delete(ParticleRenderer *particle_renderer) {
     particle_mesh_delete(&particle_renderer->particle_mesh);
     shader_program_delete(&particle_renderer->shader_program);
     particle_gpu_data_delete(&particle_renderer->gpu_data);
+
+    particle_mesh_delete(&particle_renderer->static_particle_mesh);
+    particle_gpu_data_delete(&particle_renderer->static_gpu_data);
 }
@@ -21,10 +21,20 @@ typedef struct {
     ParticleMesh particle_mesh;
     ShaderProgram shader_program;
     ParticleGpuData gpu_data;
+
+    // Static particles are drawn from their own buffers (and VAO), which are only uploaded when particles are added
+    ParticleMesh static_particle_mesh;
+    ParticleGpuData static_gpu_data;
+
+    // Set if the last upload only contained some of the particles
+    bool partial;
 } ParticleRenderer;
 
 ParticleRenderer particle_renderer_new();
-void particle_renderer_upload_from_list(ParticleRenderer *particle_renderer, ParticleList *particle_list);
+// `partial` is set if the list only contains some of the particles (e.g. the visible ones), in an order that
+// can change between uploads
+void particle_renderer_upload_from_list(ParticleRenderer *particle_renderer, ParticleList *particle_list, float alpha, bool partial);
+void particle_renderer_upload_static(ParticleRenderer *particle_renderer, ParticleList *static_list);
 void particle_renderer_draw(ParticleRenderer *particle_renderer);
 void particle_renderer_delete(ParticleRenderer *particle_renderer);
 
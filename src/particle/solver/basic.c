@@ -1,12 +1,29 @@
 #include "basic.h"
 #include "common.h"
 
-void solver_basic_solve_collisions(Solver *solver, ParticleList *list) {
+void solver_basic_solve_collisions(Solver *solver, ParticleList *list, SolverPenetration *penetration) {
     for (size_t first_idx = 0; first_idx < list->buffer_len; ++first_idx) {
         Particle *first = &list->buffer[first_idx];
         for (size_t second_idx = first_idx + 1; second_idx < list->buffer_len; ++second_idx) {
+            SolverCollisionResponse response;
+            if (!solver_collision_response_from_filters(list->filters[first_idx], list->filters[second_idx], &response)) {
+                continue;
+            }
+
             Particle *second = &list->buffer[second_idx];
-            solver_solve_particle_collision(first, second);
+            if (solver->speculative_contacts) {
+                float radius_sum = first->radius + second->radius;
+                solver_penetration_add(penetration, solver_solve_speculative_contact(first, second, response, radius_sum));
+            } else {
+                solver_penetration_add(penetration, solver_solve_particle_collision(first, second, response));
+            }
+        }
+    }
+
+    // Static particles are looked up in their grid
+    if (solver->static_particles) {
+        for (size_t idx = 0; idx < list->buffer_len; ++idx) {
+            solver_solve_static_collisions_for_particle(solver->static_particles, list, idx, penetration);
         }
     }
 }
@@ -15,14 +32,21 @@ void solver_basic_update(Solver *solver, void *data, float dt) {
     BasicSolverData *solver_data = data;
     ParticleList *list = solver_data->list;
 
-    // Apply gravity to all particles
-    solver_apply_gravity(solver, list);
-
-    // Update positions of all particles and apply constraints
+    // Update positions of all particles (adding gravity and force fields) and apply constraints
     solver_update_positions_and_apply_constraints(solver, list, dt);
 
-    // Solve collisions
-    solver_basic_solve_collisions(solver, list);
+    // Solve collisions, until the passes converge or the iteration count is reached
+    for (size_t iteration = 0; iteration < solver->collision_iterations; ++iteration) {
+        SolverPenetration penetration = solver_penetration_new();
+        solver_basic_solve_collisions(solver, list, &penetration);
+
+        if (solver_finish_collision_pass(solver, &penetration, iteration)) {
+            break;
+        }
+    }
+
+    // Solve links between particles
+    solver_solve_links(solver, list);
 }
 
 Solver solver_basic_new(Solver solver_base) {
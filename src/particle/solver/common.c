@@ -1,36 +1,391 @@
 #include "common.h"
 
-void solver_apply_gravity(Solver *solver, ParticleList *list) {
-    for (size_t i = 0; i < list->buffer_len; ++i) {
-        Particle *curr = &list->buffer[i];
-        particle_accelerate(curr, solver->gravity);
+#include <float.h>
+
+SolverUniformRadius solver_uniform_radius_new(float radius) {
+    SolverUniformRadius uniform;
+    uniform.radius = radius;
+    uniform.contact_distance = 2.0 * radius;
+    uniform.contact_distance_sq = uniform.contact_distance * uniform.contact_distance;
+    return uniform;
+}
+
+bool solver_collision_response_from_filters(
+    ParticleCollisionFilter first,
+    ParticleCollisionFilter second,
+    SolverCollisionResponse *response
+) {
+    // A particle only reacts to the other one if its mask contains the layer of the other particle
+    bool first_reacts = (first.mask & second.layer) != 0;
+    bool second_reacts = (second.mask & first.layer) != 0;
+
+    if (first_reacts && second_reacts) {
+        // Both particles are pushed apart evenly
+        response->first = 0.5;
+        response->second = 0.5;
+    } else if (first_reacts) {
+        // One-way collision: only the first particle moves
+        response->first = 1.0;
+        response->second = 0.0;
+    } else if (second_reacts) {
+        // One-way collision: only the second particle moves
+        response->first = 0.0;
+        response->second = 1.0;
+    } else {
+        // The particles don't interact at all
+        return false;
+    }
+
+    return true;
+}
+
+ForceFieldsPacked *solver_pack_force_fields(Solver *solver) {
+    if (!solver->force_fields) {
+        return NULL;
+    }
+
+    return force_fields_pack(solver->force_fields);
+}
+
+cm2_vec2 solver_uniform_acceleration(Solver *solver) {
+    if (!solver->force_fields) {
+        return solver->gravity;
+    }
+
+    return cm2_vec2_add(solver->gravity, force_fields_uniform_acceleration(solver->force_fields));
+}
+
+void solver_solve_links(Solver *solver, ParticleList *list) {
+    if (solver->links) {
+        particle_links_solve(solver->links, list);
+    }
+}
+
+float solver_step_velocity_scale(Solver *solver, float dt) {
+    // Before the first step there is no previous step length, velocities are taken as they are
+    if (solver->last_sub_dt <= 0.0) {
+        return 1.0;
+    }
+
+    return dt / solver->last_sub_dt;
+}
+
+void solver_record_displacement(Solver *solver, float max_displacement_sq, float min_radius) {
+    if (min_radius <= 0.0 || min_radius == FLT_MAX) {
+        solver->sub_step_displacement_ratio = 0.0;
+        return;
+    }
+
+    solver->sub_step_displacement_ratio = sqrtf(max_displacement_sq) / min_radius;
+}
+
+void solver_clamp_step_displacement(Particle *particle, float max_displacement) {
+    cm2_vec2 displacement = cm2_vec2_sub(particle->position, particle->last_position);
+    float displacement_sq = displacement.x * displacement.x + displacement.y * displacement.y;
+    if (displacement_sq <= max_displacement * max_displacement) {
+        return;
     }
+
+    // Shortening the displacement also shortens the implicit velocity, so the particle stays slowed down
+    float scale = max_displacement / sqrtf(displacement_sq);
+    particle->position = cm2_vec2_add(particle->last_position, cm2_vec2_scale(displacement, scale));
 }
 
 void solver_update_positions_and_apply_constraints(Solver *solver, ParticleList *list, float dt) {
+    float velocity_scale = solver_step_velocity_scale(solver, dt);
+    cm2_vec2 uniform_acceleration = solver_uniform_acceleration(solver);
+    ForceFieldsPacked *force_fields = solver_pack_force_fields(solver);
+
+    // Track how far particles moved relative to their size, so the solver can tell how much longer the next step could be
+    float max_displacement_sq = 0.0;
+    float min_radius = FLT_MAX;
+
     for (size_t i = 0; i < list->buffer_len; ++i) {
         Particle *curr = &list->buffer[i];
-        particle_update_position(curr, dt);
+
+        // Gravity and force fields are added here instead of in a separate pass over all particles
+        particle_accelerate(curr, uniform_acceleration);
+        if (force_fields) {
+            particle_accelerate(curr, force_fields_packed_acceleration_at(force_fields, curr->position));
+        }
+        particle_update_position(curr, dt, velocity_scale);
+
+        if (solver->speculative_contacts) {
+            solver_clamp_step_displacement(curr, solver->max_step_displacement_ratio * curr->radius);
+        }
 
         Constraint *constraint = solver->constraint;
         if (constraint) {
             // If the particle is outside the constraint, move it back
             constraint->apply(constraint, curr);
         }
+
+        // Only the obstacles baked into the cells that the particle moved between are tested
+        if (solver->obstacles) {
+            obstacles_apply(solver->obstacles, curr, constraint);
+        }
+
+        cm2_vec2 displacement = cm2_vec2_sub(curr->position, curr->last_position);
+        float displacement_sq = displacement.x * displacement.x + displacement.y * displacement.y;
+        if (displacement_sq > max_displacement_sq) max_displacement_sq = displacement_sq;
+        if (curr->radius < min_radius) min_radius = curr->radius;
     }
+
+    solver_record_displacement(solver, max_displacement_sq, min_radius);
+}
+
+void solver_update_positions_and_apply_constraints_uniform_radius(Solver *solver, ParticleList *list, float dt) {
+    Constraint *constraint = solver->constraint;
+    if (!constraint || !constraint->apply_baked) {
+        // Nothing to specialize
+        solver_update_positions_and_apply_constraints(solver, list, dt);
+        return;
+    }
+
+    // Bake the constraint bounds for the radius of the list (only does work if the radius has changed)
+    constraint_bake_uniform_radius(constraint, list->uniform_radius);
+
+    float velocity_scale = solver_step_velocity_scale(solver, dt);
+    cm2_vec2 uniform_acceleration = solver_uniform_acceleration(solver);
+    ForceFieldsPacked *force_fields = solver_pack_force_fields(solver);
+    float max_displacement_sq = 0.0;
+    Obstacles *obstacles = solver->obstacles;
+    bool clamp = solver->speculative_contacts;
+    float max_step_displacement = solver->max_step_displacement_ratio * list->uniform_radius;
+
+    for (size_t i = 0; i < list->buffer_len; ++i) {
+        Particle *curr = &list->buffer[i];
+        particle_accelerate(curr, uniform_acceleration);
+        if (force_fields) {
+            particle_accelerate(curr, force_fields_packed_acceleration_at(force_fields, curr->position));
+        }
+        particle_update_position(curr, dt, velocity_scale);
+        if (clamp) {
+            solver_clamp_step_displacement(curr, max_step_displacement);
+        }
+        constraint->apply_baked(constraint, curr);
+        if (obstacles) {
+            obstacles_apply(obstacles, curr, constraint);
+        }
+
+        cm2_vec2 displacement = cm2_vec2_sub(curr->position, curr->last_position);
+        float displacement_sq = displacement.x * displacement.x + displacement.y * displacement.y;
+        if (displacement_sq > max_displacement_sq) max_displacement_sq = displacement_sq;
+    }
+
+    solver_record_displacement(solver, max_displacement_sq, list->uniform_radius);
 }
 
-void solver_solve_particle_collision(Particle *first, Particle *second) {
+float solver_solve_particle_collision(Particle *first, Particle *second, SolverCollisionResponse response) {
     cm2_vec2 collision_axis = cm2_vec2_sub(first->position, second->position);
     float dist = cm2_vec2_length(collision_axis);
 
+    // Particles at exactly the same position have no collision axis, skip them instead of producing NaNs
     float radius_sum = first->radius + second->radius;
-    if (dist < radius_sum) {
+    if (dist < radius_sum && dist > 0.0) {
         cm2_vec2 normal = cm2_vec2_scale(collision_axis, 1.0 / dist);
         float delta = radius_sum - dist;
 
-        first->position = cm2_vec2_add(first->position, cm2_vec2_scale(normal, 0.5 * delta));
-        second->position = cm2_vec2_sub(second->position, cm2_vec2_scale(normal, 0.5 * delta));
+        first->position = cm2_vec2_add(first->position, cm2_vec2_scale(normal, response.first * delta));
+        second->position = cm2_vec2_sub(second->position, cm2_vec2_scale(normal, response.second * delta));
+        return delta;
+    }
+
+    return 0.0;
+}
+
+float solver_solve_particle_collision_uniform_radius(
+    Particle *first,
+    Particle *second,
+    SolverCollisionResponse response,
+    SolverUniformRadius *uniform
+) {
+    cm2_vec2 collision_axis = cm2_vec2_sub(first->position, second->position);
+
+    // Compare against the precomputed squared contact distance, so neither the radii are loaded
+    // nor the square root is computed for pairs that don't collide
+    float dist_sq = collision_axis.x * collision_axis.x + collision_axis.y * collision_axis.y;
+    if (dist_sq < uniform->contact_distance_sq && dist_sq > 0.0) {
+        float dist = sqrtf(dist_sq);
+        cm2_vec2 normal = cm2_vec2_scale(collision_axis, 1.0 / dist);
+        float delta = uniform->contact_distance - dist;
+
+        first->position = cm2_vec2_add(first->position, cm2_vec2_scale(normal, response.first * delta));
+        second->position = cm2_vec2_sub(second->position, cm2_vec2_scale(normal, response.second * delta));
+        return delta;
+    }
+
+    return 0.0;
+}
+
+float solver_solve_speculative_contact(
+    Particle *first,
+    Particle *second,
+    SolverCollisionResponse response,
+    float radius_sum
+) {
+    cm2_vec2 collision_axis = cm2_vec2_sub(first->position, second->position);
+    cm2_vec2 start_axis = cm2_vec2_sub(first->last_position, second->last_position);
+    float dist_sq = collision_axis.x * collision_axis.x + collision_axis.y * collision_axis.y;
+    float start_dot = collision_axis.x * start_axis.x + collision_axis.y * start_axis.y;
+
+    // As long as the particles haven't passed each other, the current axis separates them the right way,
+    // same as for regular contacts. This is also the case for particles that started at the same position.
+    if (start_dot > 0.0 || (start_axis.x == 0.0 && start_axis.y == 0.0)) {
+        if (dist_sq < radius_sum * radius_sum && dist_sq > 0.0) {
+            float dist = sqrtf(dist_sq);
+            cm2_vec2 normal = cm2_vec2_scale(collision_axis, 1.0 / dist);
+            float delta = radius_sum - dist;
+
+            first->position = cm2_vec2_add(first->position, cm2_vec2_scale(normal, response.first * delta));
+            second->position = cm2_vec2_sub(second->position, cm2_vec2_scale(normal, response.second * delta));
+            return delta;
+        }
+
+        return 0.0;
+    }
+
+    // The axis turned by more than 90 degrees, so the particles passed each other. Find the closest distance
+    // along their relative motion, if their swept circles never overlapped, they only passed by each other.
+    cm2_vec2 relative_displacement = cm2_vec2_sub(collision_axis, start_axis);
+    float relative_displacement_sq =
+        relative_displacement.x * relative_displacement.x + relative_displacement.y * relative_displacement.y;
+    float t = -(start_axis.x * relative_displacement.x + start_axis.y * relative_displacement.y) / relative_displacement_sq;
+    t = fminf(fmaxf(t, 0.0), 1.0);
+    cm2_vec2 closest = cm2_vec2_add(start_axis, cm2_vec2_scale(relative_displacement, t));
+    if (closest.x * closest.x + closest.y * closest.y >= radius_sum * radius_sum) {
+        return 0.0;
+    }
+
+    // They passed through each other: their separation along the axis they started on is negative.
+    // Move them back along that axis to where they touch.
+    float start_dist = cm2_vec2_length(start_axis);
+    cm2_vec2 normal = cm2_vec2_scale(start_axis, 1.0 / start_dist);
+    float delta = radius_sum - start_dot / start_dist;
+
+    first->position = cm2_vec2_add(first->position, cm2_vec2_scale(normal, response.first * delta));
+    second->position = cm2_vec2_sub(second->position, cm2_vec2_scale(normal, response.second * delta));
+    return delta;
+}
+
+float solver_solve_static_particle_collision(Particle *particle, const Particle *static_particle) {
+    cm2_vec2 collision_axis = cm2_vec2_sub(particle->position, static_particle->position);
+    float dist_sq = collision_axis.x * collision_axis.x + collision_axis.y * collision_axis.y;
+
+    float radius_sum = particle->radius + static_particle->radius;
+    if (dist_sq < radius_sum * radius_sum && dist_sq > 0.0) {
+        float dist = sqrtf(dist_sq);
+        cm2_vec2 normal = cm2_vec2_scale(collision_axis, 1.0 / dist);
+        float delta = radius_sum - dist;
+
+        // Only the simulated particle is written, so threads never write to the shared static particles
+        particle->position = cm2_vec2_add(particle->position, cm2_vec2_scale(normal, delta));
+        return delta;
+    }
+
+    return 0.0;
+}
+
+static void solver_solve_static_cell_for_particle(
+    StaticParticles *static_particles,
+    ParticleGridCell *static_cell,
+    Particle *particle,
+    ParticleCollisionFilter filter,
+    SolverPenetration *penetration
+) {
+    ParticleList *static_list = &static_particles->list;
+    for (size_t i = 0; i < static_cell->indices_len; ++i) {
+        ParticleGridCellIdx static_idx = static_cell->indices[i];
+
+        // Static particles never react, so only the mask of the simulated particle matters
+        if (!(filter.mask & static_list->filters[static_idx].layer)) {
+            continue;
+        }
+
+        Particle *static_particle = &static_list->buffer[static_idx];
+        solver_penetration_add(penetration, solver_solve_static_particle_collision(particle, static_particle));
     }
 }
 
+void solver_solve_static_neighbors(
+    StaticParticles *static_particles,
+    ParticleList *list,
+    ParticleGridCell *cell,
+    size_t x, size_t y,
+    SolverPenetration *penetration
+) {
+    ParticleGrid *static_grid = &static_particles->grid;
+    SolverPenetration cell_penetration = solver_penetration_new();
+
+    // Get static cells in 3x3 grid around the current cell
+    for (long dy = -1; dy <= 1; ++dy) {
+        for (long dx = -1; dx <= 1; ++dx) {
+            // Skip coordinates that will cause an overflow
+            if (dx == -1 && x == 0) continue;
+            if (dy == -1 && y == 0) continue;
+
+            // Skip positions that are outside of the grid
+            size_t other_x = x + dx;
+            size_t other_y = y + dy;
+            if (!particle_grid_is_position_inside_grid(static_grid, other_x, other_y)) {
+                continue;
+            }
+
+            // Skip empty cells and cells without any layer the particles in the current cell collide with
+            if (!particle_grid_is_cell_occupied(static_grid, other_x, other_y)) {
+                continue;
+            }
+
+            ParticleGridCell *static_cell = particle_grid_cell_at(static_grid, other_x, other_y);
+            if (!(cell->masks & static_cell->layers)) {
+                continue;
+            }
+
+            for (size_t i = 0; i < cell->indices_len; ++i) {
+                ParticleGridCellIdx idx = cell->indices[i];
+                solver_solve_static_cell_for_particle(
+                    static_particles, static_cell, &list->buffer[idx], list->filters[idx], &cell_penetration
+                );
+            }
+        }
+    }
+
+    solver_penetration_merge(penetration, &cell_penetration);
+}
+
+void solver_solve_static_collisions_for_particle(
+    StaticParticles *static_particles,
+    ParticleList *list,
+    size_t idx,
+    SolverPenetration *penetration
+) {
+    ParticleGrid *static_grid = &static_particles->grid;
+    Particle *particle = &list->buffer[idx];
+    ParticleCollisionFilter filter = list->filters[idx];
+
+    size_t x, y;
+    if (!particle_grid_index_from_position(static_grid, particle, &x, &y)) {
+        return;
+    }
+
+    for (long dy = -1; dy <= 1; ++dy) {
+        for (long dx = -1; dx <= 1; ++dx) {
+            if (dx == -1 && x == 0) continue;
+            if (dy == -1 && y == 0) continue;
+
+            size_t other_x = x + dx;
+            size_t other_y = y + dy;
+            if (!particle_grid_is_position_inside_grid(static_grid, other_x, other_y) ||
+                !particle_grid_is_cell_occupied(static_grid, other_x, other_y)) {
+                continue;
+            }
+
+            ParticleGridCell *static_cell = particle_grid_cell_at(static_grid, other_x, other_y);
+            if (!(filter.mask & static_cell->layers)) {
+                continue;
+            }
+
+            solver_solve_static_cell_for_particle(static_particles, static_cell, particle, filter, penetration);
+        }
+    }
+}
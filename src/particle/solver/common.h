@@ -3,8 +3,73 @@
 
 #include "solver.h"
 
-void solver_apply_gravity(Solver *solver, ParticleList *list);
+// Precomputed contact distance for lists where every particle has the same radius
+typedef struct {
+    float radius;
+    float contact_distance;
+    float contact_distance_sq;
+} SolverUniformRadius;
+
+SolverUniformRadius solver_uniform_radius_new(float radius);
+
+// Share of the collision correction that each of the two colliding particles receives
+typedef struct {
+    float first, second;
+} SolverCollisionResponse;
+
+bool solver_collision_response_from_filters(
+    ParticleCollisionFilter first,
+    ParticleCollisionFilter second,
+    SolverCollisionResponse *response
+);
+
+// Packs the force fields that depend on the particle position for the integration loop, which adds them
+// to every particle at the position before the update. NULL if there are none.
+ForceFieldsPacked *solver_pack_force_fields(Solver *solver);
+// Gravity plus all uniform force fields, added to every particle during integration
+cm2_vec2 solver_uniform_acceleration(Solver *solver);
+void solver_solve_links(Solver *solver, ParticleList *list);
+// Ratio of `dt` to the length of the previous sub step, applied to the implicit velocity of every particle
+float solver_step_velocity_scale(Solver *solver, float dt);
+// Stores the largest displacement of the current sub step relative to the smallest particle radius
+void solver_record_displacement(Solver *solver, float max_displacement_sq, float min_radius);
+// Shortens the displacement of the particle in the current sub step to at most `max_displacement`
+void solver_clamp_step_displacement(Particle *particle, float max_displacement);
 void solver_update_positions_and_apply_constraints(Solver *solver, ParticleList *list, float dt);
-void solver_solve_particle_collision(Particle *first, Particle *second);
+void solver_update_positions_and_apply_constraints_uniform_radius(Solver *solver, ParticleList *list, float dt);
+// The collision functions return the penetration depth they resolved (0 if the particles don't collide)
+float solver_solve_particle_collision(Particle *first, Particle *second, SolverCollisionResponse response);
+float solver_solve_particle_collision_uniform_radius(
+    Particle *first,
+    Particle *second,
+    SolverCollisionResponse response,
+    SolverUniformRadius *uniform
+);
+// Like `solver_solve_particle_collision`, but also catches particles that passed through each other during the
+// sub step, by testing the circles swept from `last_position`
+float solver_solve_speculative_contact(
+    Particle *first,
+    Particle *second,
+    SolverCollisionResponse response,
+    float radius_sum
+);
+
+// Static particles receive no correction, the whole penetration is resolved by moving `particle`
+float solver_solve_static_particle_collision(Particle *particle, const Particle *static_particle);
+// Solves collisions between the particles of `cell` (at x, y) and the static particles in the 3x3 cells around it
+void solver_solve_static_neighbors(
+    StaticParticles *static_particles,
+    ParticleList *list,
+    ParticleGridCell *cell,
+    size_t x, size_t y,
+    SolverPenetration *penetration
+);
+// Same as `solver_solve_static_neighbors`, for a single particle
+void solver_solve_static_collisions_for_particle(
+    StaticParticles *static_particles,
+    ParticleList *list,
+    size_t idx,
+    SolverPenetration *penetration
+);
 
 #endif /* SOLVERS_COMMON_H */
@@ -2,6 +2,7 @@
 #define GRID_BASED_SOLVER_H
 
 #include "solver.h"
+#include "common.h"
 
 typedef struct {
     ParticleGrid *grid;
@@ -13,7 +14,31 @@ void solver_grid_based_solve_neighbors(
     ParticleList *list,
     ParticleGrid *grid,
     ParticleGridCell *cell,
-    size_t x, size_t y
+    size_t x, size_t y,
+    SolverPenetration *penetration
+);
+void solver_grid_based_solve_neighbors_uniform_radius(
+    ParticleList *list,
+    ParticleGrid *grid,
+    ParticleGridCell *cell,
+    size_t x, size_t y,
+    SolverPenetration *penetration,
+    SolverUniformRadius *uniform
+);
+void solver_grid_based_solve_neighbors_speculative(
+    ParticleList *list,
+    ParticleGrid *grid,
+    ParticleGridCell *cell,
+    size_t x, size_t y,
+    SolverPenetration *penetration
+);
+void solver_grid_based_solve_neighbors_uniform_radius_speculative(
+    ParticleList *list,
+    ParticleGrid *grid,
+    ParticleGridCell *cell,
+    size_t x, size_t y,
+    SolverPenetration *penetration,
+    SolverUniformRadius *uniform
 );
 
 #endif /* GRID_BASED_SOLVER_H */
@@ -0,0 +1,115 @@
+// Template for the narrow phase of the grid-based solvers.
+//
+// This header doesn't have an include guard, since it is meant to be included once for every
+// specialization of the narrow phase. Before including it, define the following macros:
+// - GRID_KERNEL(name):                 Name of a function for this specialization
+// - GRID_KERNEL_EXTRA_PARAMS:          Additional parameters (with leading comma) of every function
+// - GRID_KERNEL_EXTRA_ARGS:            Arguments passed for GRID_KERNEL_EXTRA_PARAMS (with leading comma)
+// - GRID_KERNEL_SOLVE_PAIR(first, second, response): Expression that solves the collision between two particles
+//                                                   and evaluates to the resolved penetration depth
+//
+// All macros are undefined again at the end of this file.
+
+void GRID_KERNEL(solver_grid_based_solve_grid_cells)(
+    ParticleList *list,
+    ParticleGridCell *cell,
+    ParticleGridCell *other_cell,
+    SolverPenetration *penetration
+    GRID_KERNEL_EXTRA_PARAMS
+) {
+    // Penetration is accumulated locally and merged once at the end
+    SolverPenetration cell_penetration = solver_penetration_new();
+
+    // Iterate over particles in both cells and solve collisions between them
+    for (size_t i = 0; i < cell->indices_len; ++i) {
+        ParticleGridCellIdx first_idx = cell->indices[i];
+        ParticleCollisionFilter first_filter = list->filters[first_idx];
+
+        for (size_t j = 0; j < other_cell->indices_len; ++j) {
+            ParticleGridCellIdx second_idx = other_cell->indices[j];
+
+            // Don't solve collision for same particle
+            if (first_idx == second_idx) {
+                continue;
+            }
+
+            // Check the collision filters before touching the particles
+            SolverCollisionResponse response;
+            if (!solver_collision_response_from_filters(first_filter, list->filters[second_idx], &response)) {
+                continue;
+            }
+
+            Particle *first = &list->buffer[first_idx];
+            Particle *second = &list->buffer[second_idx];
+            solver_penetration_add(&cell_penetration, GRID_KERNEL_SOLVE_PAIR(first, second, response));
+        }
+    }
+
+    solver_penetration_merge(penetration, &cell_penetration);
+}
+
+void GRID_KERNEL(solver_grid_based_solve_neighbors)(
+    ParticleList *list,
+    ParticleGrid *grid,
+    ParticleGridCell *cell,
+    size_t x, size_t y,
+    SolverPenetration *penetration
+    GRID_KERNEL_EXTRA_PARAMS
+) {
+    // Get cells in 3x3 grid around the current cell
+    for (long dy = -1; dy <= 1; ++dy) {
+        for (long dx = -1; dx <= 1; ++dx) {
+            // Skip coordinates that will cause an overflow
+            if (dx == -1 && x == 0) continue;
+            if (dy == -1 && y == 0) continue;
+
+            // Skip positions that are outside of the grid
+            size_t other_x = x + dx;
+            size_t other_y = y + dy;
+            if (!particle_grid_is_position_inside_grid(grid, other_x, other_y)) {
+                continue;
+            }
+
+            // Skip empty cells without touching them
+            if (!particle_grid_is_cell_occupied(grid, other_x, other_y)) {
+                continue;
+            }
+
+            // Skip the whole cell if no particle in it can interact with any particle in the current cell
+            ParticleGridCell *other_cell = particle_grid_cell_at(grid, other_x, other_y);
+            if (!(cell->masks & other_cell->layers) && !(other_cell->masks & cell->layers)) {
+                continue;
+            }
+
+            GRID_KERNEL(solver_grid_based_solve_grid_cells)(list, cell, other_cell, penetration GRID_KERNEL_EXTRA_ARGS);
+        }
+    }
+}
+
+void GRID_KERNEL(solver_grid_based_solve_collisions_with_grid)(
+    Solver *solver,
+    ParticleList *list,
+    ParticleGrid *grid,
+    SolverPenetration *penetration
+    GRID_KERNEL_EXTRA_PARAMS
+) {
+    // Only visit cells that contain particles, since empty cells can't produce any collisions
+    for (size_t i = 0; i < grid->active_cells_len; ++i) {
+        size_t x, y;
+        particle_grid_cell_position(grid, grid->active_cells[i], &x, &y);
+
+        // Get the current cell and solve collisions with neighbors
+        ParticleGridCell *cell = particle_grid_cell_at(grid, x, y);
+        GRID_KERNEL(solver_grid_based_solve_neighbors)(list, grid, cell, x, y, penetration GRID_KERNEL_EXTRA_ARGS);
+
+        // Then with the static particles around the cell
+        if (solver->static_particles) {
+            solver_solve_static_neighbors(solver->static_particles, list, cell, x, y, penetration);
+        }
+    }
+}
+
+#undef GRID_KERNEL
+#undef GRID_KERNEL_EXTRA_PARAMS
+#undef GRID_KERNEL_EXTRA_ARGS
+#undef GRID_KERNEL_SOLVE_PAIR
@@ -9,53 +9,173 @@ typedef struct {
     ParticleList *list;
     ParticleGrid *grid;
     size_t start_x, end_x;
+
+    // Set if all particles have the same radius, NULL otherwise
+    SolverUniformRadius *uniform;
+
+    // Whether collisions are solved as speculative contacts
+    bool speculative;
+
+    // Static particles of the solver, NULL if there are none
+    StaticParticles *static_particles;
+
+    // Penetration resolved by this thread
+    SolverPenetration penetration;
+
+    // Active cells that lie inside of this section
+    size_t *cells;
+    size_t cells_len;
 } SectionSolverThreadArgs;
 
 void *solver_solve_section(void *argvp) {
     SectionSolverThreadArgs *args = argvp;
     ParticleGrid *grid = args->grid;
 
-    // For the parallel solver, iterating over the columns first is better, since particles are more likely
-    // to collect horizontally. By doing so, we are more likely to split up the work between threads evenly.
-    //
-    // If we were to first iterate over the rows, the last thread might spend its time computing collisions
-    // for all the particles (if they have collected at the bottom of the grid).
-    for (size_t x = args->start_x; x < args->end_x; ++x) {
-        for (size_t y = 0; y < grid->height; ++y) {
-            // Get the current cell and solve collisions with neighbors
-            ParticleGridCell *cell = particle_grid_cell_at(grid, x, y);
-            solver_grid_based_solve_neighbors(args->list, grid, cell, x, y);
+    for (size_t i = 0; i < args->cells_len; ++i) {
+        size_t x, y;
+        particle_grid_cell_position(grid, args->cells[i], &x, &y);
+
+        // Get the current cell and solve collisions with neighbors
+        ParticleGridCell *cell = particle_grid_cell_at(grid, x, y);
+        if (args->speculative) {
+            if (args->uniform) {
+                solver_grid_based_solve_neighbors_uniform_radius_speculative(
+                    args->list, grid, cell, x, y, &args->penetration, args->uniform
+                );
+            } else {
+                solver_grid_based_solve_neighbors_speculative(args->list, grid, cell, x, y, &args->penetration);
+            }
+        } else if (args->uniform) {
+            solver_grid_based_solve_neighbors_uniform_radius(args->list, grid, cell, x, y, &args->penetration, args->uniform);
+        } else {
+            solver_grid_based_solve_neighbors(args->list, grid, cell, x, y, &args->penetration);
+        }
+
+        if (args->static_particles) {
+            solver_solve_static_neighbors(args->static_particles, args->list, cell, x, y, &args->penetration);
         }
     }
 
     return NULL;
 }
 
+ParallelGridBasedSolverData solver_parallel_grid_based_data_new(ParticleGrid *grid, ParticleList *list, size_t section_count) {
+    ParallelGridBasedSolverData solver_data;
+    solver_data.grid = grid;
+    solver_data.list = list;
+    solver_data.params.section_count = section_count > 0 ? section_count : 1;
+    solver_data.section_of_column = NULL;
+    solver_data.section_of_column_cap = 0;
+    solver_data.section_cells = NULL;
+    solver_data.section_cells_cap = 0;
+    return solver_data;
+}
+
+void solver_parallel_grid_based_data_delete(ParallelGridBasedSolverData *solver_data) {
+    free(solver_data->section_of_column);
+    free(solver_data->section_cells);
+}
+
+static void solver_parallel_grid_based_reserve(ParallelGridBasedSolverData *solver_data) {
+    ParticleGrid *grid = solver_data->grid;
+    if (grid->width > solver_data->section_of_column_cap) {
+        solver_data->section_of_column_cap = grid->width;
+        solver_data->section_of_column = (size_t*) realloc(solver_data->section_of_column, sizeof(size_t) * grid->width);
+    }
+
+    if (grid->active_cells_len > solver_data->section_cells_cap) {
+        size_t cap = solver_data->section_cells_cap > 0 ? solver_data->section_cells_cap : 64;
+        while (cap < grid->active_cells_len) {
+            cap *= 2; // Grow buffer capacity exponentially
+        }
+
+        solver_data->section_cells_cap = cap;
+        solver_data->section_cells = (size_t*) realloc(solver_data->section_cells, sizeof(size_t) * cap);
+    }
+}
+
+void solver_distribute_active_cells(
+    ParticleGrid *grid,
+    SectionSolverThreadArgs *args,
+    size_t section_count,
+    size_t *section_of_column,
+    size_t *section_cells
+) {
+    // Map each column to the section that contains it
+    for (size_t i = 0; i < section_count; ++i) {
+        for (size_t x = args[i].start_x; x < args[i].end_x; ++x) {
+            section_of_column[x] = i;
+        }
+    }
+
+    // Count the active cells of each section
+    for (size_t i = 0; i < section_count; ++i) {
+        args[i].cells_len = 0;
+    }
+
+    for (size_t i = 0; i < grid->active_cells_len; ++i) {
+        size_t x, y;
+        particle_grid_cell_position(grid, grid->active_cells[i], &x, &y);
+        args[section_of_column[x]].cells_len++;
+    }
+
+    // Give every section its own contiguous slice of `section_cells` ...
+    size_t offset = 0;
+    for (size_t i = 0; i < section_count; ++i) {
+        args[i].cells = &section_cells[offset];
+        offset += args[i].cells_len;
+        args[i].cells_len = 0;
+    }
+
+    // ... and fill it with the section's active cells
+    for (size_t i = 0; i < grid->active_cells_len; ++i) {
+        size_t x, y;
+        particle_grid_cell_position(grid, grid->active_cells[i], &x, &y);
+
+        SectionSolverThreadArgs *section_args = &args[section_of_column[x]];
+        section_args->cells[section_args->cells_len] = grid->active_cells[i];
+        section_args->cells_len++;
+    }
+}
+
 void solver_solve_collisions_with_grid_parallel(
     Solver *solver,
-    ParticleList *list,
-    ParticleGrid *grid,
-    ParallelGridBasedSolverParams *params
+    ParallelGridBasedSolverData *solver_data,
+    SolverPenetration *penetration
 ) {
-    // Limit section count to the grid width
+    ParticleList *list = solver_data->list;
+    ParticleGrid *grid = solver_data->grid;
+    ParallelGridBasedSolverParams *params = &solver_data->params;
+
+    // Sections are made up of whole columns of tiles, so that tiles are the unit of work for each thread.
+    // Limit section count to the number of tile columns.
     size_t section_count = params->section_count;
-    if (params->section_count > grid->width) {
-        section_count = grid->width;
+    if (params->section_count > grid->tiles_x) {
+        section_count = grid->tiles_x;
     }
 
-    size_t section_width = grid->width / section_count;
+    size_t section_width = grid->tiles_x / section_count;
 
-    size_t section_remainder = grid->width % section_count;
+    size_t section_remainder = grid->tiles_x % section_count;
 
     size_t curr_start_x = 0;
     size_t curr_end_x = section_width;
 
-    SectionSolverThreadArgs *args = (SectionSolverThreadArgs*)
-        malloc(sizeof(SectionSolverThreadArgs) * section_count);
+    SectionSolverThreadArgs args[section_count];
     pthread_t thread_ids[section_count];
 
+    // Use the specialized narrow phase if all particles have the same radius
+    SolverUniformRadius uniform;
+    SolverUniformRadius *uniform_ptr = NULL;
+    if (list->has_uniform_radius) {
+        uniform = solver_uniform_radius_new(list->uniform_radius);
+        uniform_ptr = &uniform;
+    }
+
     // Create section arguments
     for (size_t i = 0; i < section_count; ++i) {
+        // The width is measured in tile columns here.
+        //
         // First consider the easiest case: the split count evenly divides the width of the grid
         // For example: width = 9, section_count = 3
         // One row is divided like the following: # # # | # # # | # # #
@@ -75,28 +195,45 @@ void solver_solve_collisions_with_grid_parallel(
             section_remainder--;
         }
 
-        // Create arguments with the list, grid and current start and end indices
+        // Create arguments with the list, grid and current start and end indices (converted from tiles to cells,
+        // the last tile column might extend past the grid)
         args[i].list = list;
         args[i].grid = grid;
-        args[i].start_x = curr_start_x;
-        args[i].end_x = curr_end_x;
+        args[i].uniform = uniform_ptr;
+        args[i].speculative = solver->speculative_contacts;
+        args[i].static_particles = solver->static_particles;
+        args[i].penetration = solver_penetration_new();
+        args[i].start_x = curr_start_x * PARTICLE_GRID_TILE_SIZE;
+        args[i].end_x = curr_end_x * PARTICLE_GRID_TILE_SIZE;
+        if (args[i].end_x > grid->width) {
+            args[i].end_x = grid->width;
+        }
 
         // The new start value is now `curr_end_x` and the end value is incremented by `section_width`
         curr_start_x = curr_end_x;
         curr_end_x += section_width;
     }
 
+    // For the parallel solver, splitting the grid into columns is better, since particles are more likely
+    // to collect horizontally. By doing so, we are more likely to split up the work between threads evenly.
+    //
+    // If we were to split the grid into rows, the last thread might spend its time computing collisions
+    // for all the particles (if they have collected at the bottom of the grid).
+    //
+    // Each section only gets the active cells in its columns, so that threads don't have to walk over empty cells.
+    solver_parallel_grid_based_reserve(solver_data);
+    solver_distribute_active_cells(grid, args, section_count, solver_data->section_of_column, solver_data->section_cells);
+
     // Spawn threads
     for (size_t i = 0; i < section_count; ++i) {
         pthread_create(&thread_ids[i], NULL, solver_solve_section, &args[i]);
     }
 
-    // Wait for all threads to finish
+    // Wait for all threads to finish and combine the penetration each of them resolved
     for (size_t i = 0; i < section_count; ++i) {
         pthread_join(thread_ids[i], NULL);
+        solver_penetration_merge(penetration, &args[i].penetration);
     }
-
-    free(args);
 }
 
 
@@ -104,20 +241,30 @@ void solver_parallel_grid_based_update(Solver *solver, void *data, float dt) {
     ParallelGridBasedSolverData* solver_data = data;
     ParticleList *list = solver_data->list;
     ParticleGrid *grid = solver_data->grid;
-    ParallelGridBasedSolverParams *params = &solver_data->params;
-
-    // Apply gravity to all particles
-    solver_apply_gravity(solver, list);
 
-    // Update positions of all particles and apply constraints
-    solver_update_positions_and_apply_constraints(solver, list, dt);
+    // Update positions of all particles (adding gravity and force fields) and apply constraints
+    if (list->has_uniform_radius) {
+        solver_update_positions_and_apply_constraints_uniform_radius(solver, list, dt);
+    } else {
+        solver_update_positions_and_apply_constraints(solver, list, dt);
+    }
 
     // Clear grid and insert particles into it
     particle_grid_clear(grid);
     particle_grid_insert_all(grid, list);
 
-    // Solve collisions
-    solver_solve_collisions_with_grid_parallel(solver, list, grid, params);
+    // Solve collisions, until the passes converge or the iteration count is reached
+    for (size_t iteration = 0; iteration < solver->collision_iterations; ++iteration) {
+        SolverPenetration penetration = solver_penetration_new();
+        solver_solve_collisions_with_grid_parallel(solver, solver_data, &penetration);
+
+        if (solver_finish_collision_pass(solver, &penetration, iteration)) {
+            break;
+        }
+    }
+
+    // Solve links between particles
+    solver_solve_links(solver, list);
 }
 
 Solver solver_parallel_grid_based_new(Solver solver_base) {
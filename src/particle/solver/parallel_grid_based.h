@@ -11,8 +11,18 @@ typedef struct {
     ParticleGrid *grid;
     ParticleList *list;
     ParallelGridBasedSolverParams params;
+
+    // Section of each grid column and the active cells sorted by section, kept between collision passes so
+    // they are only reallocated when the grid gets wider or more cells become active
+    size_t *section_of_column;
+    size_t section_of_column_cap;
+    size_t *section_cells;
+    size_t section_cells_cap;
 } ParallelGridBasedSolverData;
 
+ParallelGridBasedSolverData solver_parallel_grid_based_data_new(ParticleGrid *grid, ParticleList *list, size_t section_count);
+void solver_parallel_grid_based_data_delete(ParallelGridBasedSolverData *solver_data);
+
 Solver solver_parallel_grid_based_new(Solver solver_base);
 
 #endif /* PARALLEL_GRID_BASED_SOLVER_H */
@@ -5,21 +5,216 @@
 
 #include "../../../thirdparty/c_log.h"
 
+SolverPenetration solver_penetration_new() {
+    SolverPenetration penetration;
+    penetration.max = 0.0;
+    penetration.total = 0.0;
+    penetration.contacts = 0;
+    return penetration;
+}
+
+void solver_penetration_add(SolverPenetration *penetration, float depth) {
+    if (depth <= 0.0) {
+        return;
+    }
+
+    if (depth > penetration->max) penetration->max = depth;
+    penetration->total += depth;
+    penetration->contacts++;
+}
+
+void solver_penetration_merge(SolverPenetration *penetration, SolverPenetration *other) {
+    if (other->max > penetration->max) penetration->max = other->max;
+    penetration->total += other->total;
+    penetration->contacts += other->contacts;
+}
+
+float solver_penetration_mean(SolverPenetration *penetration) {
+    if (penetration->contacts == 0) {
+        return 0.0;
+    }
+
+    return penetration->total / (float)penetration->contacts;
+}
+
 Solver solver_new(float delta_time, size_t sub_steps) {
     Solver solver;
     solver.delta_time = delta_time;
     solver.sub_steps = sub_steps;
+    solver.base_sub_steps = sub_steps;
     solver.gravity = cm2_vec2_new(0.0, -5000.0);
     solver.constraint = NULL;
+    solver.static_particles = NULL;
+    solver.obstacles = NULL;
+    solver.force_fields = NULL;
+    solver.links = NULL;
+
+    solver.adaptive_sub_steps = false;
+    solver.min_sub_steps = SOLVER_DEFAULT_MIN_SUB_STEPS;
+    solver.max_sub_steps = SOLVER_DEFAULT_MAX_SUB_STEPS;
+    solver.max_displacement_ratio = SOLVER_DEFAULT_MAX_DISPLACEMENT_RATIO;
+    solver.max_penetration_ratio = SOLVER_DEFAULT_MAX_PENETRATION_RATIO;
+
+    solver.convergence_tolerance = 0.0;
+    solver.collision_iterations = 1;
+    solver.min_full_sub_steps = SOLVER_DEFAULT_MIN_FULL_SUB_STEPS;
+    solver.speculative_contacts = false;
+    solver.max_step_displacement_ratio = SOLVER_DEFAULT_MAX_STEP_DISPLACEMENT_RATIO;
+    solver.last_sub_dt = 0.0;
+    solver.sub_step_converged = false;
+    solver.sub_step_displacement_ratio = 0.0;
+
+    solver.stats.sub_steps = sub_steps;
+    solver.stats.max_displacement = 0.0;
+    solver.stats.penetration = solver_penetration_new();
+    solver.stats.first_pass_penetration = solver_penetration_new();
+    solver.stats.collision_passes = 0;
     return solver;
 }
 
+void solver_enable_adaptive_sub_steps(Solver *solver, size_t min_sub_steps, size_t max_sub_steps) {
+    solver->adaptive_sub_steps = true;
+    solver->min_sub_steps = min_sub_steps;
+    solver->max_sub_steps = max_sub_steps;
+}
+
+void solver_enable_early_exit(Solver *solver, float convergence_tolerance, size_t collision_iterations, size_t min_full_sub_steps) {
+    solver->convergence_tolerance = convergence_tolerance;
+    solver->collision_iterations = collision_iterations > 0 ? collision_iterations : 1;
+    solver->min_full_sub_steps = min_full_sub_steps;
+}
+
+void solver_enable_speculative_contacts(Solver *solver, float max_step_displacement_ratio) {
+    solver->speculative_contacts = true;
+    solver->max_step_displacement_ratio = max_step_displacement_ratio;
+}
+
+bool solver_finish_collision_pass(Solver *solver, SolverPenetration *penetration, size_t iteration) {
+    solver_penetration_merge(&solver->stats.penetration, penetration);
+    solver->stats.collision_passes++;
+
+    bool converged = solver->convergence_tolerance > 0.0 && penetration->max <= solver->convergence_tolerance;
+    if (iteration == 0) {
+        solver_penetration_merge(&solver->stats.first_pass_penetration, penetration);
+        solver->sub_step_converged = converged;
+    }
+
+    return converged;
+}
+
+void solver_adapt_sub_steps(Solver *solver, ParticleList *list) {
+    if (!solver->adaptive_sub_steps || list->buffer_len == 0) {
+        return;
+    }
+
+    // Find the largest displacement of the last sub step and the smallest radius
+    float max_displacement_sq = 0.0;
+    float min_radius = FLT_MAX;
+    for (size_t i = 0; i < list->buffer_len; ++i) {
+        Particle *particle = &list->buffer[i];
+        cm2_vec2 displacement = cm2_vec2_sub(particle->position, particle->last_position);
+        float displacement_sq = displacement.x * displacement.x + displacement.y * displacement.y;
+        if (displacement_sq > max_displacement_sq) max_displacement_sq = displacement_sq;
+        if (particle->radius < min_radius) min_radius = particle->radius;
+    }
+
+    float max_displacement = sqrtf(max_displacement_sq);
+    solver->stats.max_displacement = max_displacement;
+
+    // The displacement per sub step scales with the sub step length. Over a whole update, the fastest particle
+    // moves `max_displacement * delta_time / last_sub_dt`, so that's the distance that has to be split into small
+    // enough sub steps.
+    float update_displacement = max_displacement * (float)solver->sub_steps;
+    if (solver->last_sub_dt > 0.0) {
+        update_displacement = max_displacement * solver->delta_time / solver->last_sub_dt;
+    }
+    float max_sub_step_displacement = solver->max_displacement_ratio * min_radius;
+    size_t sub_steps = (size_t) ceilf(update_displacement / max_sub_step_displacement);
+
+    // Penetration depth grows roughly linearly with the sub step length, so scale the current sub step count
+    // by how far the mean penetration of the last update was off the target. The mean is used instead of the
+    // maximum, since a few deep contacts (e.g. freshly spawned particles) don't depend on the sub step length.
+    float max_sub_step_penetration = solver->max_penetration_ratio * min_radius;
+    float mean_penetration = solver_penetration_mean(&solver->stats.first_pass_penetration);
+    size_t penetration_sub_steps = (size_t)
+        ceilf((float)solver->sub_steps * mean_penetration / max_sub_step_penetration);
+    if (penetration_sub_steps > sub_steps) sub_steps = penetration_sub_steps;
+
+    if (sub_steps < solver->min_sub_steps) sub_steps = solver->min_sub_steps;
+    if (sub_steps > solver->max_sub_steps) sub_steps = solver->max_sub_steps;
+
+    // The integration scales the implicit velocity of each particle by the ratio of the new and the
+    // previous sub step length, so particles keep their actual velocity when the count changes
+    solver->sub_steps = sub_steps;
+}
+
+float solver_velocity_scale(Solver *solver) {
+    // The displacement per sub step is proportional to the sub step length. New particles are integrated
+    // relative to the length of the previous sub step.
+    float base_sub_dt = solver->delta_time / (float)solver->base_sub_steps;
+    if (solver->last_sub_dt > 0.0) {
+        return solver->last_sub_dt / base_sub_dt;
+    }
+
+    return (float)solver->base_sub_steps / (float)solver->sub_steps;
+}
+
+static size_t solver_merged_sub_step_count(Solver *solver, float sub_dt, size_t sub_steps_run, size_t sub_steps_left) {
+    if (solver->convergence_tolerance <= 0.0 || !solver->sub_step_converged || sub_steps_run < solver->min_full_sub_steps) {
+        return 1;
+    }
+
+    // The displacement grows linearly with the step length, so limit the merged step to the length
+    // at which the fastest particle would move further than allowed
+    size_t merged = sub_steps_left;
+    float displacement_ratio = solver->sub_step_displacement_ratio * sub_dt / solver->last_sub_dt;
+    if (displacement_ratio > 0.0) {
+        float max_merged = floorf(solver->max_displacement_ratio / displacement_ratio);
+        if (max_merged < 1.0) {
+            return 1;
+        }
+        if (max_merged < (float)merged) {
+            merged = (size_t) max_merged;
+        }
+    }
+
+    return merged;
+}
+
 void solver_update(Solver *solver) {
     float sub_dt = solver->delta_time / (float)solver->sub_steps;
 
-    for (size_t i = 0; i < solver->sub_steps; ++i) {
-        solver->update(solver, solver->update_data, sub_dt);
+    // Reset stats that are collected over all sub steps
+    solver->stats.penetration = solver_penetration_new();
+    solver->stats.first_pass_penetration = solver_penetration_new();
+    solver->stats.collision_passes = 0;
+
+    // Static particles only have to be inserted into their grid once
+    if (solver->static_particles) {
+        static_particles_insert_new(solver->static_particles);
     }
+
+    // Rebuild the obstacle cell lists if segments were added
+    if (solver->obstacles && !solver->obstacles->is_baked) {
+        obstacles_bake(solver->obstacles);
+    }
+
+    // Once a sub step has converged, the remaining ones are merged into fewer, longer steps
+    size_t sub_steps_run = 0;
+    size_t sub_steps_left = solver->sub_steps;
+    while (sub_steps_left > 0) {
+        size_t merged = solver_merged_sub_step_count(solver, sub_dt, sub_steps_run, sub_steps_left);
+        float dt = sub_dt * (float)merged;
+
+        solver->sub_step_converged = false;
+        solver->update(solver, solver->update_data, dt);
+        solver->last_sub_dt = dt;
+
+        sub_steps_left -= merged;
+        sub_steps_run++;
+    }
+
+    solver->stats.sub_steps = sub_steps_run;
 }
 
 void solver_delete(Solver *solver) {
@@ -6,9 +6,71 @@
 #include "../constraint.h"
 #include "../grid/grid.h"
 #include "../list.h"
+#include "../force_field.h"
+#include "../links.h"
+#include "../obstacles/obstacles.h"
+#include "../static_particles.h"
 
 #include "../../../thirdparty/c_math2d.h"
 
+// Default bounds and target for adaptive sub steps
+#ifndef SOLVER_DEFAULT_MIN_SUB_STEPS
+#define SOLVER_DEFAULT_MIN_SUB_STEPS 2
+#endif /* SOLVER_DEFAULT_MIN_SUB_STEPS */
+
+#ifndef SOLVER_DEFAULT_MAX_SUB_STEPS
+#define SOLVER_DEFAULT_MAX_SUB_STEPS 16
+#endif /* SOLVER_DEFAULT_MAX_SUB_STEPS */
+
+#ifndef SOLVER_DEFAULT_MAX_DISPLACEMENT_RATIO
+#define SOLVER_DEFAULT_MAX_DISPLACEMENT_RATIO 0.5
+#endif /* SOLVER_DEFAULT_MAX_DISPLACEMENT_RATIO */
+
+#ifndef SOLVER_DEFAULT_MAX_PENETRATION_RATIO
+#define SOLVER_DEFAULT_MAX_PENETRATION_RATIO 0.03
+#endif /* SOLVER_DEFAULT_MAX_PENETRATION_RATIO */
+
+// Default number of sub steps at the start of each update that run at full length before early exit can merge
+// the remaining ones. Collisions from integration only show up after a sub step, so the first one alone can't
+// tell whether the particles have settled.
+#ifndef SOLVER_DEFAULT_MIN_FULL_SUB_STEPS
+#define SOLVER_DEFAULT_MIN_FULL_SUB_STEPS 2
+#endif /* SOLVER_DEFAULT_MIN_FULL_SUB_STEPS */
+
+// Default displacement limit per sub step (relative to the particle radius) for speculative contacts
+#ifndef SOLVER_DEFAULT_MAX_STEP_DISPLACEMENT_RATIO
+#define SOLVER_DEFAULT_MAX_STEP_DISPLACEMENT_RATIO 1.0
+#endif /* SOLVER_DEFAULT_MAX_STEP_DISPLACEMENT_RATIO */
+
+// Penetration that was resolved by collision passes
+typedef struct {
+    float max;
+    float total;
+    size_t contacts;
+} SolverPenetration;
+
+SolverPenetration solver_penetration_new();
+void solver_penetration_add(SolverPenetration *penetration, float depth);
+void solver_penetration_merge(SolverPenetration *penetration, SolverPenetration *other);
+float solver_penetration_mean(SolverPenetration *penetration);
+
+typedef struct {
+    // Number of sub steps used by the last update
+    size_t sub_steps;
+
+    // Largest distance a particle travelled in one sub step, measured before the last update
+    float max_displacement;
+
+    // Penetration resolved over all sub steps of the last update
+    SolverPenetration penetration;
+
+    // Penetration resolved by the first collision pass of each sub step, i.e. the penetration caused by integration
+    SolverPenetration first_pass_penetration;
+
+    // Number of collision passes over all sub steps of the last update
+    size_t collision_passes;
+} SolverStats;
+
 struct Solver;
 
 typedef void (*SolverUpdateFn)(struct Solver *solver, void *data, float dt);
@@ -17,9 +79,60 @@ struct Solver {
     float delta_time;
     size_t sub_steps;
 
+    // Sub step count the solver was created with. Velocities (the difference between the current
+    // and last position of a particle) of new particles are given relative to this sub step count.
+    size_t base_sub_steps;
+
+    // Adaptive sub steps: if enabled, `solver_adapt_sub_steps` picks `sub_steps` within [min_sub_steps, max_sub_steps],
+    // so that in one sub step
+    // - no particle moves further than `max_displacement_ratio` times the smallest particle radius and
+    // - collisions penetrate no deeper than `max_penetration_ratio` times the smallest particle radius on average.
+    bool adaptive_sub_steps;
+    size_t min_sub_steps, max_sub_steps;
+    float max_displacement_ratio;
+    float max_penetration_ratio;
+
+    // Early exit: the collision pass of a sub step is repeated up to `collision_iterations` times, until a pass resolves
+    // no penetration deeper than `convergence_tolerance`. Once the first pass of a sub step stays below the tolerance,
+    // the remaining sub steps are merged into longer ones, as far as `max_displacement_ratio` allows. The first
+    // `min_full_sub_steps` sub steps of an update always run at full length. A tolerance of 0 disables early exit.
+    float convergence_tolerance;
+    size_t collision_iterations;
+    size_t min_full_sub_steps;
+
+    // Speculative contacts: the displacement of a particle in one sub step is clamped to `max_step_displacement_ratio`
+    // times its radius, and collisions also test the circles swept by the particles during the sub step. Particles that
+    // passed through each other are moved back along the axis between their start positions, which keeps fast particles
+    // from tunneling at low sub step counts.
+    bool speculative_contacts;
+    float max_step_displacement_ratio;
+
+    // Length of the previous sub step
+    float last_sub_dt;
+
+    // Whether the first collision pass of the current sub step stayed below the tolerance
+    bool sub_step_converged;
+
+    // Largest displacement of the current sub step relative to the smallest particle radius
+    float sub_step_displacement_ratio;
+
+    SolverStats stats;
+
     cm2_vec2 gravity;
     Constraint *constraint;
 
+    // Particles that the simulated particles collide with, but that are never moved (optional)
+    StaticParticles *static_particles;
+
+    // Static collision geometry, applied to every particle during integration (optional)
+    Obstacles *obstacles;
+
+    // Force fields in addition to gravity (optional)
+    ForceFields *force_fields;
+
+    // Distance constraints between particles, solved after the collisions of every sub step (optional)
+    ParticleLinks *links;
+
     void *update_data;
     SolverUpdateFn update;
 };
@@ -28,6 +141,13 @@ typedef struct Solver Solver;
 
 
 Solver solver_new(float delta_time, size_t sub_steps);
+void solver_enable_adaptive_sub_steps(Solver *solver, size_t min_sub_steps, size_t max_sub_steps);
+void solver_adapt_sub_steps(Solver *solver, ParticleList *list);
+void solver_enable_early_exit(Solver *solver, float convergence_tolerance, size_t collision_iterations, size_t min_full_sub_steps);
+void solver_enable_speculative_contacts(Solver *solver, float max_step_displacement_ratio);
+// Records the penetration of a collision pass, returns true if no further pass is needed in this sub step
+bool solver_finish_collision_pass(Solver *solver, SolverPenetration *penetration, size_t iteration);
+float solver_velocity_scale(Solver *solver);
 void solver_update(Solver *solver);
 void solver_delete(Solver *solver);
 
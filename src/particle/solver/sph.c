@@ -0,0 +1,573 @@
+#include "sph.h"
+#include "common.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "../../../thirdparty/c_log.h"
+
+// Added to distances before dividing by them, so that a particle's own entry in its neighborhood
+// (at distance 0) contributes nothing instead of NaNs
+#define SPH_DISTANCE_EPSILON 1e-4
+
+// Constants of the smoothing kernels (2D):
+// - poly6:  W(r)  = 4 / (pi h^8) * (h^2 - r^2)^3, used for the density and viscosity
+// - spiky: ∇W(r) = -30 / (pi h^5) * (h - r)^2 * r / |r|, used for the constraint gradients
+typedef struct {
+    float h, h_sq;
+    float poly6;
+    float spiky_gradient;
+    float inv_rest_density;
+    float relaxation;
+
+    // Inverse of the unnormalized poly6 kernel at the tensile distance
+    float inv_tensile_reference;
+    float tensile_strength;
+    float viscosity;
+} SphKernel;
+
+static float sph_poly6(float h, float r_sq) {
+    float q = fmaxf(h * h - r_sq, 0.0);
+    return 4.0 / ((float)M_PI * powf(h, 8.0)) * q * q * q;
+}
+
+static float sph_spiky_gradient(float h, float r) {
+    float s = fmaxf(h - r, 0.0);
+    return 30.0 / ((float)M_PI * powf(h, 5.0)) * s * s;
+}
+
+SphSolverParams solver_sph_params_new(float particle_radius, float smoothing_radius, size_t section_count) {
+    SphSolverParams params;
+    params.section_count = section_count > 0 ? section_count : 1;
+    params.smoothing_radius = smoothing_radius;
+    params.relaxation = SPH_DEFAULT_RELAXATION;
+    params.tensile_strength = SPH_DEFAULT_TENSILE_STRENGTH;
+    params.tensile_distance = SPH_DEFAULT_TENSILE_DISTANCE;
+    params.viscosity = SPH_DEFAULT_VISCOSITY;
+
+    // Measure the rest state on rows of touching particles, every other row shifted by half a particle
+    float spacing = 2.0 * particle_radius;
+    float row_height = spacing * sqrtf(3.0) / 2.0;
+    long rows = (long)ceilf(smoothing_radius / row_height);
+    long columns = (long)ceilf(smoothing_radius / spacing) + 1;
+
+    params.rest_density = 0.0;
+    params.rest_gradient_sq = 0.0;
+    for (long row = -rows; row <= rows; ++row) {
+        float offset = (row % 2 != 0) ? 0.5 * spacing : 0.0;
+        for (long column = -columns; column <= columns; ++column) {
+            float x = (float)column * spacing + offset;
+            float y = (float)row * row_height;
+            float r_sq = x * x + y * y;
+            if (r_sq >= smoothing_radius * smoothing_radius) {
+                continue;
+            }
+
+            params.rest_density += sph_poly6(smoothing_radius, r_sq);
+            if (r_sq > 0.0) {
+                float gradient = sph_spiky_gradient(smoothing_radius, sqrtf(r_sq));
+                params.rest_gradient_sq += gradient * gradient;
+            }
+        }
+    }
+
+    return params;
+}
+
+static SphKernel sph_kernel_new(SphSolverParams *params) {
+    SphKernel kernel;
+    kernel.h = params->smoothing_radius;
+    kernel.h_sq = kernel.h * kernel.h;
+    kernel.poly6 = 4.0 / ((float)M_PI * powf(kernel.h, 8.0));
+    kernel.spiky_gradient = 30.0 / ((float)M_PI * powf(kernel.h, 5.0));
+    kernel.inv_rest_density = 1.0 / params->rest_density;
+
+    // The denominator of the density constraint is the summed squared gradient divided by the squared rest density
+    kernel.relaxation = params->relaxation * params->rest_gradient_sq * kernel.inv_rest_density * kernel.inv_rest_density;
+
+    float tensile_r = params->tensile_distance * kernel.h;
+    float tensile_q = kernel.h_sq - tensile_r * tensile_r;
+    kernel.inv_tensile_reference = 1.0 / (tensile_q * tensile_q * tensile_q);
+    kernel.tensile_strength = params->tensile_strength;
+    kernel.viscosity = params->viscosity;
+    return kernel;
+}
+
+SphSolverData solver_sph_data_new(ParticleGrid *grid, ParticleList *list, SphSolverParams params) {
+    // Neighbors are only searched in the 3x3 cells around a particle
+    float max_smoothing_radius = fminf(grid->cell_width, grid->cell_height);
+    if (params.smoothing_radius > max_smoothing_radius) {
+        c_log(C_LOG_SEVERITY_WARNING, "SPH smoothing radius %f is larger than a grid cell, clamping it to %f",
+              params.smoothing_radius, max_smoothing_radius);
+        params.smoothing_radius = max_smoothing_radius;
+    }
+
+    SphSolverData solver_data;
+    solver_data.grid = grid;
+    solver_data.list = list;
+    solver_data.params = params;
+    solver_data.particles_cap = 0;
+    solver_data.lambdas = NULL;
+    solver_data.corrections = NULL;
+    solver_data.neighborhoods = NULL;
+    solver_data.neighborhoods_len = 0;
+    return solver_data;
+}
+
+void solver_sph_data_delete(SphSolverData *solver_data) {
+    free(solver_data->lambdas);
+    free(solver_data->corrections);
+
+    for (size_t i = 0; i < solver_data->neighborhoods_len; ++i) {
+        free(solver_data->neighborhoods[i].x);
+        free(solver_data->neighborhoods[i].y);
+        free(solver_data->neighborhoods[i].a);
+        free(solver_data->neighborhoods[i].b);
+    }
+    free(solver_data->neighborhoods);
+}
+
+static void solver_sph_reserve(SphSolverData *solver_data, size_t particle_count) {
+    if (particle_count <= solver_data->particles_cap) {
+        return;
+    }
+
+    size_t cap = solver_data->particles_cap > 0 ? solver_data->particles_cap : PARTICLE_LIST_INITIAL_CAP;
+    while (cap < particle_count) {
+        cap *= 2; // Grow buffer capacity exponentially
+    }
+
+    solver_data->particles_cap = cap;
+    solver_data->lambdas = (float*) realloc(solver_data->lambdas, sizeof(float) * cap);
+    solver_data->corrections = (cm2_vec2*) realloc(solver_data->corrections, sizeof(cm2_vec2) * cap);
+}
+
+static void solver_sph_reserve_neighborhoods(SphSolverData *solver_data, size_t thread_count) {
+    if (thread_count <= solver_data->neighborhoods_len) {
+        return;
+    }
+
+    // The section count can be raised while the solver runs, new threads start with empty neighborhoods
+    solver_data->neighborhoods = (SphNeighborhood*) realloc(solver_data->neighborhoods, sizeof(SphNeighborhood) * thread_count);
+    for (size_t i = solver_data->neighborhoods_len; i < thread_count; ++i) {
+        solver_data->neighborhoods[i] = (SphNeighborhood) { NULL, NULL, NULL, NULL, 0, 0 };
+    }
+    solver_data->neighborhoods_len = thread_count;
+}
+
+typedef enum {
+    SPH_PASS_DENSITY,
+    SPH_PASS_PRESSURE,
+    SPH_PASS_APPLY_PRESSURE,
+    SPH_PASS_VISCOSITY,
+    SPH_PASS_APPLY_VISCOSITY,
+} SphPass;
+
+typedef struct SphThreadArgs SphThreadArgs;
+
+// State of a sub step that all threads share
+typedef struct {
+    SphThreadArgs *args;
+    size_t section_count;
+    pthread_barrier_t barrier;
+
+    // Set by the first thread after each pressure pass, so all threads leave the iterations together
+    bool converged;
+} SphSubStep;
+
+struct SphThreadArgs {
+    Solver *solver;
+    SphSolverData *data;
+    SphKernel *kernel;
+    SphSubStep *sub_step;
+    size_t thread_idx;
+    SphPass pass;
+
+    // Active cells handled by this thread
+    size_t *cells;
+    size_t cells_len;
+
+    SphNeighborhood *neighborhood;
+
+    // Correction applied by this thread in the pressure pass
+    SolverPenetration penetration;
+};
+
+static void sph_neighborhood_push(SphNeighborhood *neighborhood, float x, float y, float a, float b) {
+    if (neighborhood->len >= neighborhood->cap) {
+        neighborhood->cap = neighborhood->cap > 0 ? neighborhood->cap * 2 : 64;
+        neighborhood->x = (float*) realloc(neighborhood->x, sizeof(float) * neighborhood->cap);
+        neighborhood->y = (float*) realloc(neighborhood->y, sizeof(float) * neighborhood->cap);
+        neighborhood->a = (float*) realloc(neighborhood->a, sizeof(float) * neighborhood->cap);
+        neighborhood->b = (float*) realloc(neighborhood->b, sizeof(float) * neighborhood->cap);
+    }
+
+    size_t i = neighborhood->len;
+    neighborhood->x[i] = x;
+    neighborhood->y[i] = y;
+    neighborhood->a[i] = a;
+    neighborhood->b[i] = b;
+    neighborhood->len++;
+}
+
+static void sph_gather_neighborhood(SphThreadArgs *args, size_t x, size_t y) {
+    ParticleGrid *grid = args->data->grid;
+    ParticleList *list = args->data->list;
+    SphNeighborhood *neighborhood = args->neighborhood;
+    neighborhood->len = 0;
+
+    for (long dy = -1; dy <= 1; ++dy) {
+        for (long dx = -1; dx <= 1; ++dx) {
+            // Skip coordinates that will cause an overflow
+            if (dx == -1 && x == 0) continue;
+            if (dy == -1 && y == 0) continue;
+
+            size_t other_x = x + dx;
+            size_t other_y = y + dy;
+            if (!particle_grid_is_position_inside_grid(grid, other_x, other_y)) {
+                continue;
+            }
+            if (!particle_grid_is_cell_occupied(grid, other_x, other_y)) {
+                continue;
+            }
+
+            ParticleGridCell *other_cell = particle_grid_cell_at(grid, other_x, other_y);
+            for (size_t i = 0; i < other_cell->indices_len; ++i) {
+                ParticleGridCellIdx idx = other_cell->indices[i];
+                Particle *particle = &list->buffer[idx];
+
+                // The extra values depend on the pass: the multiplier of the density constraint for the
+                // pressure pass, the velocity (as the displacement of the last step) for the viscosity pass
+                float a = 0.0, b = 0.0;
+                if (args->pass == SPH_PASS_PRESSURE) {
+                    a = args->data->lambdas[idx];
+                } else if (args->pass == SPH_PASS_VISCOSITY) {
+                    a = particle->position.x - particle->last_position.x;
+                    b = particle->position.y - particle->last_position.y;
+                }
+
+                sph_neighborhood_push(neighborhood, particle->position.x, particle->position.y, a, b);
+            }
+        }
+    }
+}
+
+static void sph_solve_density(SphThreadArgs *args, ParticleGridCell *cell) {
+    SphKernel *kernel = args->kernel;
+    SphNeighborhood *neighborhood = args->neighborhood;
+    ParticleList *list = args->data->list;
+
+    for (size_t i = 0; i < cell->indices_len; ++i) {
+        ParticleGridCellIdx idx = cell->indices[i];
+        float px = list->buffer[idx].position.x;
+        float py = list->buffer[idx].position.y;
+
+        // Kernel sums without their constant factors, those are applied once afterwards
+        float density = 0.0;
+        float gradient_x = 0.0, gradient_y = 0.0;
+        float gradient_sq = 0.0;
+        for (size_t j = 0; j < neighborhood->len; ++j) {
+            float dx = px - neighborhood->x[j];
+            float dy = py - neighborhood->y[j];
+            float r_sq = dx * dx + dy * dy;
+            float r = sqrtf(r_sq);
+
+            float q = fmaxf(kernel->h_sq - r_sq, 0.0);
+            density += q * q * q;
+
+            float s = fmaxf(kernel->h - r, 0.0);
+            float g = s * s / (r + SPH_DISTANCE_EPSILON);
+            gradient_x += g * dx;
+            gradient_y += g * dy;
+            gradient_sq += g * g * r_sq;
+        }
+
+        density *= kernel->poly6;
+
+        // Only compression is corrected. Particles with too few neighbors (at the surface) would
+        // otherwise be pulled into clumps.
+        float constraint = fmaxf(density * kernel->inv_rest_density - 1.0, 0.0);
+
+        float gradient_scale = kernel->spiky_gradient * kernel->inv_rest_density;
+        float gradient_sum_sq = (gradient_x * gradient_x + gradient_y * gradient_y + gradient_sq) * gradient_scale * gradient_scale;
+        args->data->lambdas[idx] = -constraint / (gradient_sum_sq + kernel->relaxation);
+    }
+}
+
+static void sph_solve_pressure(SphThreadArgs *args, ParticleGridCell *cell) {
+    SphKernel *kernel = args->kernel;
+    SphNeighborhood *neighborhood = args->neighborhood;
+    ParticleList *list = args->data->list;
+
+    for (size_t i = 0; i < cell->indices_len; ++i) {
+        ParticleGridCellIdx idx = cell->indices[i];
+        float px = list->buffer[idx].position.x;
+        float py = list->buffer[idx].position.y;
+        float lambda = args->data->lambdas[idx];
+
+        float correction_x = 0.0, correction_y = 0.0;
+        for (size_t j = 0; j < neighborhood->len; ++j) {
+            float dx = px - neighborhood->x[j];
+            float dy = py - neighborhood->y[j];
+            float r_sq = dx * dx + dy * dy;
+            float r = sqrtf(r_sq);
+
+            // Artificial pressure, grows with the fourth power of the kernel relative to its value at the tensile distance
+            float q = fmaxf(kernel->h_sq - r_sq, 0.0);
+            float w = q * q * q * kernel->inv_tensile_reference;
+            float w_sq = w * w;
+            float tensile = -kernel->tensile_strength * w_sq * w_sq;
+
+            float s = fmaxf(kernel->h - r, 0.0);
+            float g = s * s / (r + SPH_DISTANCE_EPSILON) * (lambda + neighborhood->a[j] + tensile);
+            correction_x += g * dx;
+            correction_y += g * dy;
+        }
+
+        // The spiky gradient points from the particle towards its neighbor, hence the negative sign
+        float scale = -kernel->spiky_gradient * kernel->inv_rest_density;
+        cm2_vec2 correction = cm2_vec2_new(correction_x * scale, correction_y * scale);
+        args->data->corrections[idx] = correction;
+        solver_penetration_add(&args->penetration, cm2_vec2_length(correction));
+    }
+}
+
+static void sph_solve_viscosity(SphThreadArgs *args, ParticleGridCell *cell) {
+    SphKernel *kernel = args->kernel;
+    SphNeighborhood *neighborhood = args->neighborhood;
+    ParticleList *list = args->data->list;
+
+    for (size_t i = 0; i < cell->indices_len; ++i) {
+        ParticleGridCellIdx idx = cell->indices[i];
+        Particle *particle = &list->buffer[idx];
+        float px = particle->position.x;
+        float py = particle->position.y;
+        float vx = px - particle->last_position.x;
+        float vy = py - particle->last_position.y;
+
+        float blend_x = 0.0, blend_y = 0.0;
+        for (size_t j = 0; j < neighborhood->len; ++j) {
+            float dx = px - neighborhood->x[j];
+            float dy = py - neighborhood->y[j];
+            float r_sq = dx * dx + dy * dy;
+
+            float q = fmaxf(kernel->h_sq - r_sq, 0.0);
+            float w = q * q * q;
+            blend_x += (neighborhood->a[j] - vx) * w;
+            blend_y += (neighborhood->b[j] - vy) * w;
+        }
+
+        // At rest density, the kernel weights divided by the rest density add up to one
+        float scale = kernel->viscosity * kernel->poly6 * kernel->inv_rest_density;
+        args->data->corrections[idx] = cm2_vec2_new(blend_x * scale, blend_y * scale);
+    }
+}
+
+static void sph_apply_corrections(SphThreadArgs *args, ParticleGridCell *cell) {
+    Solver *solver = args->solver;
+    ParticleList *list = args->data->list;
+
+    for (size_t i = 0; i < cell->indices_len; ++i) {
+        ParticleGridCellIdx idx = cell->indices[i];
+        Particle *particle = &list->buffer[idx];
+        cm2_vec2 correction = args->data->corrections[idx];
+
+        if (args->pass == SPH_PASS_APPLY_VISCOSITY) {
+            // Changing the velocity means moving the last position, since velocities are implicit
+            particle->last_position = cm2_vec2_sub(particle->last_position, correction);
+            continue;
+        }
+
+        // Pressure moves particles, which can push them out of the constraint or into obstacles
+        particle->position = cm2_vec2_add(particle->position, correction);
+        if (solver->constraint) {
+            solver->constraint->apply(solver->constraint, particle);
+        }
+        if (solver->obstacles) {
+            obstacles_apply(solver->obstacles, particle, solver->constraint);
+        }
+    }
+}
+
+void *solver_sph_solve_section(void *argvp) {
+    SphThreadArgs *args = argvp;
+    ParticleGrid *grid = args->data->grid;
+
+    for (size_t i = 0; i < args->cells_len; ++i) {
+        size_t x, y;
+        particle_grid_cell_position(grid, args->cells[i], &x, &y);
+        ParticleGridCell *cell = particle_grid_cell_at(grid, x, y);
+
+        switch (args->pass) {
+        case SPH_PASS_DENSITY:
+            sph_gather_neighborhood(args, x, y);
+            sph_solve_density(args, cell);
+            break;
+        case SPH_PASS_PRESSURE:
+            sph_gather_neighborhood(args, x, y);
+            sph_solve_pressure(args, cell);
+            break;
+        case SPH_PASS_VISCOSITY:
+            sph_gather_neighborhood(args, x, y);
+            sph_solve_viscosity(args, cell);
+            break;
+        case SPH_PASS_APPLY_PRESSURE:
+        case SPH_PASS_APPLY_VISCOSITY:
+            sph_apply_corrections(args, cell);
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void solver_sph_run_pass(SphThreadArgs *args, SphPass pass) {
+    args->pass = pass;
+    solver_sph_solve_section(args);
+
+    // Every pass only writes the state of the particles in the thread's own cells, and passes that
+    // read positions never run at the same time as passes that write them
+    pthread_barrier_wait(&args->sub_step->barrier);
+}
+
+// Runs all passes of a sub step on one thread. The threads are only started once per sub step, and wait
+// for each other between the passes.
+void *solver_sph_run_sub_step(void *argvp) {
+    SphThreadArgs *args = argvp;
+    SphSubStep *sub_step = args->sub_step;
+    Solver *solver = args->solver;
+
+    // Solve the density constraint, until the passes converge or the iteration count is reached
+    for (size_t iteration = 0; iteration < solver->collision_iterations; ++iteration) {
+        solver_sph_run_pass(args, SPH_PASS_DENSITY);
+
+        args->penetration = solver_penetration_new();
+        solver_sph_run_pass(args, SPH_PASS_PRESSURE);
+        solver_sph_run_pass(args, SPH_PASS_APPLY_PRESSURE);
+
+        // The pressure corrections take the place of the penetration resolved by a collision pass
+        if (args->thread_idx == 0) {
+            SolverPenetration penetration = solver_penetration_new();
+            for (size_t i = 0; i < sub_step->section_count; ++i) {
+                solver_penetration_merge(&penetration, &sub_step->args[i].penetration);
+            }
+            sub_step->converged = solver_finish_collision_pass(solver, &penetration, iteration);
+        }
+        pthread_barrier_wait(&sub_step->barrier);
+
+        if (sub_step->converged) {
+            break;
+        }
+    }
+
+    // Blend velocities with the neighbors' velocities
+    solver_sph_run_pass(args, SPH_PASS_VISCOSITY);
+    solver_sph_run_pass(args, SPH_PASS_APPLY_VISCOSITY);
+
+    return NULL;
+}
+
+static size_t solver_sph_split_active_cells(ParticleGrid *grid, SphThreadArgs *args, size_t section_count) {
+    // Unlike collisions, the passes never write to neighboring particles, so threads don't need to be kept
+    // apart spatially. The active cells are split into runs with about the same number of particles instead.
+    size_t particle_count = 0;
+    for (size_t i = 0; i < grid->active_cells_len; ++i) {
+        size_t x, y;
+        particle_grid_cell_position(grid, grid->active_cells[i], &x, &y);
+        particle_count += particle_grid_cell_at(grid, x, y)->indices_len;
+    }
+
+    size_t per_section = particle_count / section_count + 1;
+    size_t section = 0;
+    size_t section_particles = 0;
+    args[0].cells = grid->active_cells;
+    args[0].cells_len = 0;
+
+    for (size_t i = 0; i < grid->active_cells_len; ++i) {
+        if (section_particles >= per_section && section + 1 < section_count) {
+            section++;
+            section_particles = 0;
+            args[section].cells = &grid->active_cells[i];
+            args[section].cells_len = 0;
+        }
+
+        size_t x, y;
+        particle_grid_cell_position(grid, grid->active_cells[i], &x, &y);
+        section_particles += particle_grid_cell_at(grid, x, y)->indices_len;
+        args[section].cells_len++;
+    }
+
+    return section + 1;
+}
+
+void solver_sph_update(Solver *solver, void *data, float dt) {
+    SphSolverData *solver_data = data;
+    ParticleList *list = solver_data->list;
+    ParticleGrid *grid = solver_data->grid;
+
+    // Update positions of all particles (adding gravity and force fields) and apply constraints,
+    // this predicts the positions that the passes correct
+    if (list->has_uniform_radius) {
+        solver_update_positions_and_apply_constraints_uniform_radius(solver, list, dt);
+    } else {
+        solver_update_positions_and_apply_constraints(solver, list, dt);
+    }
+
+    // Clear grid and insert particles into it
+    particle_grid_clear(grid);
+    particle_grid_insert_all(grid, list);
+
+    solver_sph_reserve(solver_data, list->buffer_len);
+    SphKernel kernel = sph_kernel_new(&solver_data->params);
+
+    size_t section_count = solver_data->params.section_count;
+    solver_sph_reserve_neighborhoods(solver_data, section_count);
+
+    SphSubStep sub_step;
+    SphThreadArgs args[section_count];
+    for (size_t i = 0; i < section_count; ++i) {
+        args[i].solver = solver;
+        args[i].data = solver_data;
+        args[i].kernel = &kernel;
+        args[i].sub_step = &sub_step;
+        args[i].thread_idx = i;
+        args[i].neighborhood = &solver_data->neighborhoods[i];
+    }
+    section_count = solver_sph_split_active_cells(grid, args, section_count);
+
+    sub_step.args = args;
+    sub_step.section_count = section_count;
+    sub_step.converged = false;
+    pthread_barrier_init(&sub_step.barrier, NULL, section_count);
+
+    // The calling thread takes the first section
+    pthread_t thread_ids[section_count];
+    for (size_t i = 1; i < section_count; ++i) {
+        pthread_create(&thread_ids[i], NULL, solver_sph_run_sub_step, &args[i]);
+    }
+    solver_sph_run_sub_step(&args[0]);
+
+    for (size_t i = 1; i < section_count; ++i) {
+        pthread_join(thread_ids[i], NULL);
+    }
+    pthread_barrier_destroy(&sub_step.barrier);
+
+    // Static particles are solid, they are collided with like in the other solvers. This happens after the
+    // pressure iterations, so it doesn't take part in their convergence, but counts towards the stats.
+    if (solver->static_particles) {
+        SolverPenetration static_penetration = solver_penetration_new();
+        for (size_t idx = 0; idx < list->buffer_len; ++idx) {
+            solver_solve_static_collisions_for_particle(solver->static_particles, list, idx, &static_penetration);
+        }
+        solver_penetration_merge(&solver->stats.penetration, &static_penetration);
+    }
+
+    // Solve links between particles
+    solver_solve_links(solver, list);
+}
+
+Solver solver_sph_new(Solver solver_base) {
+    solver_base.update = solver_sph_update;
+    return solver_base;
+}
@@ -0,0 +1,83 @@
+#ifndef SPH_SOLVER_H
+#define SPH_SOLVER_H
+
+#include "solver.h"
+
+// Share of the density constraint gradient (at rest density) that is added to its denominator. Keeps the
+// pressure pass from overshooting where particles have few neighbors.
+#ifndef SPH_DEFAULT_RELAXATION
+#define SPH_DEFAULT_RELAXATION 0.5
+#endif /* SPH_DEFAULT_RELAXATION */
+
+// Strength of the artificial pressure that keeps particles from clumping together
+#ifndef SPH_DEFAULT_TENSILE_STRENGTH
+#define SPH_DEFAULT_TENSILE_STRENGTH 0.05
+#endif /* SPH_DEFAULT_TENSILE_STRENGTH */
+
+// Fraction of the smoothing radius at which the artificial pressure is measured
+#ifndef SPH_DEFAULT_TENSILE_DISTANCE
+#define SPH_DEFAULT_TENSILE_DISTANCE 0.2
+#endif /* SPH_DEFAULT_TENSILE_DISTANCE */
+
+// Share of the velocity difference to its neighbors that a particle takes on in the viscosity pass
+#ifndef SPH_DEFAULT_VISCOSITY
+#define SPH_DEFAULT_VISCOSITY 0.05
+#endif /* SPH_DEFAULT_VISCOSITY */
+
+typedef struct {
+    // Number of threads that the particles are split across
+    size_t section_count;
+
+    // Radius of the smoothing kernels, can't be larger than a grid cell
+    float smoothing_radius;
+
+    // Density of particles at rest and the summed squared kernel gradients of a particle at rest, both
+    // measured on a hexagonal packing of particles that just touch each other
+    float rest_density;
+    float rest_gradient_sq;
+
+    float relaxation;
+    float tensile_strength;
+    float tensile_distance;
+    float viscosity;
+} SphSolverParams;
+
+SphSolverParams solver_sph_params_new(float particle_radius, float smoothing_radius, size_t section_count);
+
+// The particles in the 3x3 cells around a cell, gathered into flat arrays. The inner loops of the
+// passes run over these arrays without branches, so the compiler can vectorize them.
+typedef struct {
+    float *x, *y;
+    float *a, *b;
+    size_t len, cap;
+} SphNeighborhood;
+
+// Fluid solver based on smoothed particle hydrodynamics. Incompressibility is enforced as a density
+// constraint on the particle positions (position based fluids), which fits the Verlet integration of
+// the other solvers: every sub step integrates the particles and then runs
+// - a density pass, which estimates the density of each particle from its neighbors in the grid,
+// - a pressure pass, which moves particles to bring the density back to the rest density and
+// - a viscosity pass, which blends the velocity of each particle with the velocities of its neighbors.
+// Every particle in the list is treated as fluid with the same mass, radii only matter for the
+// constraint, obstacles and static particles.
+typedef struct {
+    ParticleGrid *grid;
+    ParticleList *list;
+    SphSolverParams params;
+
+    // Per particle state of the passes, grown with the list
+    float *lambdas;
+    cm2_vec2 *corrections;
+    size_t particles_cap;
+
+    // Neighborhood of each thread, kept between sub steps so that they only grow while the fluid settles
+    SphNeighborhood *neighborhoods;
+    size_t neighborhoods_len;
+} SphSolverData;
+
+SphSolverData solver_sph_data_new(ParticleGrid *grid, ParticleList *list, SphSolverParams params);
+void solver_sph_data_delete(SphSolverData *solver_data);
+
+Solver solver_sph_new(Solver solver_base);
+
+#endif /* SPH_SOLVER_H */
@@ -0,0 +1,133 @@
+#include "sweep_and_prune.h"
+#include "common.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+SweepAndPruneSolverData solver_sweep_and_prune_data_new(ParticleList *list) {
+    SweepAndPruneSolverData solver_data;
+    solver_data.list = list;
+    solver_data.entries_len = 0;
+    solver_data.entries_cap = SWEEP_AND_PRUNE_INITIAL_CAP;
+    solver_data.entries = (SweepAndPruneEntry*) malloc(sizeof(SweepAndPruneEntry) * solver_data.entries_cap);
+    return solver_data;
+}
+
+void solver_sweep_and_prune_data_delete(SweepAndPruneSolverData *solver_data) {
+    free(solver_data->entries);
+}
+
+void solver_sweep_and_prune_append_new_particles(SweepAndPruneSolverData *solver_data) {
+    ParticleList *list = solver_data->list;
+
+    // Particles are only ever appended to the list, so every index at or above `entries_len`
+    // hasn't been added to the sorted entries yet
+    for (size_t idx = solver_data->entries_len; idx < list->buffer_len; ++idx) {
+        if (solver_data->entries_len >= solver_data->entries_cap) {
+            solver_data->entries_cap *= 2; // Grow buffer capacity exponentially
+            solver_data->entries = (SweepAndPruneEntry*)
+                realloc(solver_data->entries, sizeof(SweepAndPruneEntry) * solver_data->entries_cap);
+        }
+
+        solver_data->entries[solver_data->entries_len].idx = idx;
+        solver_data->entries_len++;
+    }
+}
+
+void solver_sweep_and_prune_sort(SweepAndPruneSolverData *solver_data, bool swept) {
+    ParticleList *list = solver_data->list;
+    SweepAndPruneEntry *entries = solver_data->entries;
+
+    // Refresh the interval of every entry from the current particle positions. Speculative contacts need
+    // the interval that the particle swept over during the sub step.
+    for (size_t i = 0; i < solver_data->entries_len; ++i) {
+        Particle *particle = &list->buffer[entries[i].idx];
+        float min_x = particle->position.x, max_x = particle->position.x;
+        if (swept) {
+            min_x = fminf(min_x, particle->last_position.x);
+            max_x = fmaxf(max_x, particle->last_position.x);
+        }
+
+        entries[i].min_x = min_x - particle->radius;
+        entries[i].max_x = max_x + particle->radius;
+    }
+
+    // Particles barely move between two sub steps, so the entries from the last sub step are
+    // almost sorted already. Insertion sort runs in close to linear time on such input, which
+    // is why it's preferred over a general purpose sort here.
+    for (size_t i = 1; i < solver_data->entries_len; ++i) {
+        SweepAndPruneEntry entry = entries[i];
+        size_t j = i;
+        while (j > 0 && entries[j - 1].min_x > entry.min_x) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+}
+
+void solver_sweep_and_prune_solve_collisions(Solver *solver, SweepAndPruneSolverData *solver_data, SolverPenetration *penetration) {
+    ParticleList *list = solver_data->list;
+    SweepAndPruneEntry *entries = solver_data->entries;
+
+    // Sweep over the sorted intervals. Since they are sorted by their start, all intervals that overlap
+    // with the current one directly follow it, and the inner loop can stop at the first one that starts
+    // after the current interval ends.
+    for (size_t i = 0; i < solver_data->entries_len; ++i) {
+        Particle *first = &list->buffer[entries[i].idx];
+        ParticleCollisionFilter first_filter = list->filters[entries[i].idx];
+        float max_x = entries[i].max_x;
+
+        for (size_t j = i + 1; j < solver_data->entries_len && entries[j].min_x <= max_x; ++j) {
+            SolverCollisionResponse response;
+            if (!solver_collision_response_from_filters(first_filter, list->filters[entries[j].idx], &response)) {
+                continue;
+            }
+
+            Particle *second = &list->buffer[entries[j].idx];
+            if (solver->speculative_contacts) {
+                float radius_sum = first->radius + second->radius;
+                solver_penetration_add(penetration, solver_solve_speculative_contact(first, second, response, radius_sum));
+            } else {
+                solver_penetration_add(penetration, solver_solve_particle_collision(first, second, response));
+            }
+        }
+    }
+
+    // Static particles aren't part of the sorted entries, look them up in their grid instead
+    if (solver->static_particles) {
+        for (size_t idx = 0; idx < list->buffer_len; ++idx) {
+            solver_solve_static_collisions_for_particle(solver->static_particles, list, idx, penetration);
+        }
+    }
+}
+
+void solver_sweep_and_prune_update(Solver *solver, void *data, float dt) {
+    SweepAndPruneSolverData *solver_data = data;
+    ParticleList *list = solver_data->list;
+
+    // Update positions of all particles (adding gravity and force fields) and apply constraints
+    solver_update_positions_and_apply_constraints(solver, list, dt);
+
+    // Add new particles and restore the order along the x axis
+    solver_sweep_and_prune_append_new_particles(solver_data);
+    solver_sweep_and_prune_sort(solver_data, solver->speculative_contacts);
+
+    // Solve collisions, until the passes converge or the iteration count is reached
+    for (size_t iteration = 0; iteration < solver->collision_iterations; ++iteration) {
+        SolverPenetration penetration = solver_penetration_new();
+        solver_sweep_and_prune_solve_collisions(solver, solver_data, &penetration);
+
+        if (solver_finish_collision_pass(solver, &penetration, iteration)) {
+            break;
+        }
+    }
+
+    // Solve links between particles
+    solver_solve_links(solver, list);
+}
+
+Solver solver_sweep_and_prune_new(Solver solver_base) {
+    solver_base.update = solver_sweep_and_prune_update;
+    return solver_base;
+}
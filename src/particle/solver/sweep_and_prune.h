@@ -0,0 +1,26 @@
+#ifndef SWEEP_AND_PRUNE_SOLVER_H
+#define SWEEP_AND_PRUNE_SOLVER_H
+
+#include "solver.h"
+
+#ifndef SWEEP_AND_PRUNE_INITIAL_CAP
+#define SWEEP_AND_PRUNE_INITIAL_CAP 16
+#endif /* SWEEP_AND_PRUNE_INITIAL_CAP */
+
+typedef struct {
+    float min_x, max_x;
+    size_t idx;
+} SweepAndPruneEntry;
+
+typedef struct {
+    ParticleList *list;
+    SweepAndPruneEntry *entries;
+    size_t entries_len, entries_cap;
+} SweepAndPruneSolverData;
+
+SweepAndPruneSolverData solver_sweep_and_prune_data_new(ParticleList *list);
+void solver_sweep_and_prune_data_delete(SweepAndPruneSolverData *solver_data);
+
+Solver solver_sweep_and_prune_new(Solver solver_base);
+
+#endif /* SWEEP_AND_PRUNE_SOLVER_H */
@@ -0,0 +1,54 @@
+#include "static_particles.h"
+
+StaticParticles static_particles_fit_grid(ParticleGrid *grid) {
+    StaticParticles static_particles;
+    static_particles.list = particle_list_new();
+    static_particles.grid = particle_grid_new(grid->width, grid->height, grid->cell_width, grid->cell_height);
+    static_particles.inserted_len = 0;
+    return static_particles;
+}
+
+void static_particles_push(StaticParticles *static_particles, Particle particle, ParticleCollisionFilter filter) {
+    particle_list_push_with_filter(&static_particles->list, particle, filter);
+}
+
+void static_particles_push_line(
+    StaticParticles *static_particles,
+    cm2_vec2 from, cm2_vec2 to,
+    float radius,
+    cm2_vec4 color,
+    ParticleCollisionFilter filter
+) {
+    // Place particles one radius apart, so neighbors overlap and nothing slips through between them
+    cm2_vec2 direction = cm2_vec2_sub(to, from);
+    size_t segments = (size_t) ceilf(cm2_vec2_length(direction) / radius);
+    if (segments == 0) segments = 1;
+
+    for (size_t i = 0; i <= segments; ++i) {
+        cm2_vec2 position = cm2_vec2_add(from, cm2_vec2_scale(direction, (float)i / (float)segments));
+        Particle particle = particle_new(position.x, position.y, radius, color.x, color.y, color.z, color.w);
+        static_particles_push(static_particles, particle, filter);
+    }
+}
+
+void static_particles_insert_new(StaticParticles *static_particles) {
+    ParticleList *list = &static_particles->list;
+    if (static_particles->inserted_len == list->buffer_len) {
+        return;
+    }
+
+    // Static particles don't move, so the grid never has to be cleared. Only the particles that
+    // were pushed since the last call are inserted.
+    for (size_t idx = static_particles->inserted_len; idx < list->buffer_len; ++idx) {
+        Particle *particle = &list->buffer[idx];
+        particle_grid_insert_index_for_particle(&static_particles->grid, particle, idx, list->filters[idx]);
+    }
+
+    particle_grid_sort_active_cells(&static_particles->grid);
+    static_particles->inserted_len = list->buffer_len;
+}
+
+void static_particles_delete(StaticParticles *static_particles) {
+    particle_grid_delete(&static_particles->grid);
+    particle_list_delete(&static_particles->list);
+}
@@ -0,0 +1,33 @@
+#ifndef STATIC_PARTICLES_H
+#define STATIC_PARTICLES_H
+
+#include "grid/grid.h"
+#include "list.h"
+
+// Particles that never move (walls, containers, ramps, ...). They are kept apart from the simulated particles,
+// are never integrated and are inserted into their own grid only once. During collision resolution, they are
+// only read: a simulated particle that touches a static one receives the whole correction.
+//
+// The grid has the same dimensions as the grid of the simulated particles, so both can be indexed
+// with the same cell coordinates.
+typedef struct {
+    ParticleList list;
+    ParticleGrid grid;
+
+    // Particles below this index have been inserted into the grid already
+    size_t inserted_len;
+} StaticParticles;
+
+StaticParticles static_particles_fit_grid(ParticleGrid *grid);
+void static_particles_push(StaticParticles *static_particles, Particle particle, ParticleCollisionFilter filter);
+void static_particles_push_line(
+    StaticParticles *static_particles,
+    cm2_vec2 from, cm2_vec2 to,
+    float radius,
+    cm2_vec4 color,
+    ParticleCollisionFilter filter
+);
+void static_particles_insert_new(StaticParticles *static_particles);
+void static_particles_delete(StaticParticles *static_particles);
+
+#endif /* STATIC_PARTICLES_H */
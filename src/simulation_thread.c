@@ -0,0 +1,137 @@
+#include "simulation_thread.h"
+
+#include <float.h>
+#include <stdlib.h>
+
+#include "../thirdparty/c_log.h"
+
+SimulationThread simulation_thread_new(ParticleUpdater *updater) {
+    SimulationThread simulation_thread;
+    simulation_thread.updater = updater;
+    simulation_thread.governor = NULL;
+    simulation_thread.cull_grid = NULL;
+    simulation_thread.apply_input = NULL;
+    simulation_thread.apply_input_data = NULL;
+    simulation_thread.snapshots = snapshot_buffer_new();
+    simulation_thread.published_count = 0;
+    simulation_thread.input.cursor = cm2_vec2_new(0.0, 0.0);
+    simulation_thread.input.view_min = cm2_vec2_new(-FLT_MAX, -FLT_MAX);
+    simulation_thread.input.view_max = cm2_vec2_new(FLT_MAX, FLT_MAX);
+    simulation_thread.input.primary_pressed = false;
+    simulation_thread.input.secondary_pressed = false;
+    simulation_thread.input.density_lod = false;
+    simulation_thread.running = false;
+    return simulation_thread;
+}
+
+// Culls the particles to the view of `input`, if there is one and culling is enabled
+static void simulation_thread_publish(SimulationThread *simulation_thread, SimulationInput *input) {
+    ParticleUpdater *updater = simulation_thread->updater;
+    ParticleSnapshot *snapshot = snapshot_buffer_write_snapshot(&simulation_thread->snapshots);
+
+    // Zoomed out far enough, the renderer only needs the density of each cell. Otherwise, leave out the particles
+    // that are far from the view, so neither the copy nor the upload has to touch them.
+    if (simulation_thread->cull_grid && input && input->density_lod) {
+        particle_snapshot_fill_density(snapshot, &updater->particle_list, simulation_thread->cull_grid);
+    } else if (simulation_thread->cull_grid && input) {
+        particle_snapshot_copy_visible(
+            snapshot, &updater->particle_list, simulation_thread->cull_grid, input->view_min, input->view_max
+        );
+    } else {
+        particle_snapshot_copy(snapshot, &updater->particle_list);
+    }
+
+    // The accumulator is measured at the time of the last advance, so the render thread continues from there
+    snapshot->step_accumulator = updater->step_accumulator;
+    snapshot->step_interval = updater->step_interval;
+    snapshot->publish_time = updater->last_advance_time;
+    snapshot->sub_steps = updater->solver.stats.sub_steps;
+    snapshot->sequence = simulation_thread->published_count++;
+
+    snapshot_buffer_publish(&simulation_thread->snapshots);
+}
+
+static void simulation_thread_sleep_ms(float milliseconds) {
+    struct timespec duration;
+    duration.tv_sec = (time_t) (milliseconds / 1000.0);
+    duration.tv_nsec = (long) ((milliseconds - (float) duration.tv_sec * 1000.0) * 1000000.0);
+    nanosleep(&duration, NULL);
+}
+
+static void *simulation_thread_run(void *arg) {
+    SimulationThread *simulation_thread = arg;
+    ParticleUpdater *updater = simulation_thread->updater;
+    FrameGovernor *governor = simulation_thread->governor;
+
+    while (true) {
+        pthread_mutex_lock(&simulation_thread->mutex);
+        bool running = simulation_thread->running;
+        SimulationInput input = simulation_thread->input;
+        pthread_mutex_unlock(&simulation_thread->mutex);
+
+        if (!running) {
+            break;
+        }
+
+        if (simulation_thread->apply_input) {
+            simulation_thread->apply_input(updater, input, simulation_thread->apply_input_data);
+        }
+
+        // Run as many simulation steps as real time requires
+        if (governor) frame_governor_begin_phase(governor);
+        size_t steps = particle_updater_advance(updater);
+        if (governor) frame_governor_end_phase(governor, FRAME_GOVERNOR_PHASE_SIMULATION);
+
+        if (steps > 0) {
+            if (governor) frame_governor_begin_phase(governor);
+            simulation_thread_publish(simulation_thread, &input);
+            if (governor) frame_governor_end_phase(governor, FRAME_GOVERNOR_PHASE_SNAPSHOT);
+
+            if (governor) frame_governor_end_frame(governor);
+        }
+
+        // Wait until the next step is due instead of spinning
+        float wait = updater->step_interval - updater->step_accumulator;
+        if (wait > 0.0) {
+            simulation_thread_sleep_ms(wait);
+        }
+    }
+
+    return NULL;
+}
+
+void simulation_thread_start(SimulationThread *simulation_thread) {
+    // Make the initial state available before the first step. The particles aren't in the grid yet,
+    // so this one is complete.
+    simulation_thread_publish(simulation_thread, NULL);
+
+    pthread_mutex_init(&simulation_thread->mutex, NULL);
+    simulation_thread->running = true;
+    if (pthread_create(&simulation_thread->thread, NULL, simulation_thread_run, simulation_thread) != 0) {
+        c_log(C_LOG_SEVERITY_ERROR, "Failed to create simulation thread");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void simulation_thread_set_input(SimulationThread *simulation_thread, SimulationInput input) {
+    pthread_mutex_lock(&simulation_thread->mutex);
+    simulation_thread->input = input;
+    pthread_mutex_unlock(&simulation_thread->mutex);
+}
+
+ParticleSnapshot *simulation_thread_read_snapshot(SimulationThread *simulation_thread) {
+    return snapshot_buffer_read_snapshot(&simulation_thread->snapshots);
+}
+
+void simulation_thread_stop(SimulationThread *simulation_thread) {
+    pthread_mutex_lock(&simulation_thread->mutex);
+    simulation_thread->running = false;
+    pthread_mutex_unlock(&simulation_thread->mutex);
+
+    pthread_join(simulation_thread->thread, NULL);
+    pthread_mutex_destroy(&simulation_thread->mutex);
+}
+
+void simulation_thread_delete(SimulationThread *simulation_thread) {
+    snapshot_buffer_delete(&simulation_thread->snapshots);
+}
@@ -0,0 +1,63 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include "governor.h"
+#include "snapshot.h"
+#include "updater.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// Input from the window, passed from the render thread to the simulation thread
+typedef struct {
+    // Cursor position and visible part of the world, in world coordinates
+    cm2_vec2 cursor;
+    cm2_vec2 view_min, view_max;
+
+    // Asks for the density of the grid cells instead of the particles, see `particle_snapshot_fill_density`
+    bool density_lod;
+    bool primary_pressed;
+    bool secondary_pressed;
+} SimulationInput;
+
+// Applies the input to the simulation, called on the simulation thread before the steps are run
+typedef void (*SimulationInputCallback)(ParticleUpdater *updater, SimulationInput input, void *data);
+
+// Runs the simulation on its own thread, so the solver doesn't wait for the GPU or the swap and rendering
+// doesn't wait for a long batch of steps. After every batch of steps, the particle state is published to a
+// triple buffer of snapshots, and the render thread draws the newest one. The updater must not be touched by
+// any other thread while the simulation thread runs.
+typedef struct {
+    ParticleUpdater *updater;
+
+    // Optional, keeps the simulation thread in real time. The frames of the governor are the batches of steps.
+    FrameGovernor *governor;
+
+    // Optional, grid that the solver inserts the particles into. If set, snapshots only contain the particles
+    // in the cells around the view of the input (or only the density of the cells, if the input asks for it).
+    ParticleGrid *cull_grid;
+
+    SimulationInputCallback apply_input;
+    void *apply_input_data;
+
+    SnapshotBuffer snapshots;
+    size_t published_count;
+
+    // Guards the input and the running flag
+    pthread_mutex_t mutex;
+    SimulationInput input;
+    bool running;
+    pthread_t thread;
+} SimulationThread;
+
+SimulationThread simulation_thread_new(ParticleUpdater *updater);
+// Publishes the current state and starts the thread. The thread refers to `simulation_thread`,
+// so it can't be moved until the thread is stopped.
+void simulation_thread_start(SimulationThread *simulation_thread);
+void simulation_thread_set_input(SimulationThread *simulation_thread, SimulationInput input);
+// Newest state of the simulation, which stays valid until the next call
+ParticleSnapshot *simulation_thread_read_snapshot(SimulationThread *simulation_thread);
+void simulation_thread_stop(SimulationThread *simulation_thread);
+void simulation_thread_delete(SimulationThread *simulation_thread);
+
+#endif /* SIMULATION_THREAD_H */
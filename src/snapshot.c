@@ -0,0 +1,224 @@
+#include "snapshot.h"
+
+#include "util/math.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+ParticleSnapshot particle_snapshot_new() {
+    ParticleSnapshot snapshot;
+    snapshot.particle_list = particle_list_new();
+    snapshot.complete = true;
+    snapshot.total_particle_count = 0;
+    snapshot.has_density = false;
+    snapshot.density = NULL;
+    snapshot.density_sums = NULL;
+    snapshot.density_width = 0;
+    snapshot.density_height = 0;
+    snapshot.step_accumulator = 0.0;
+    snapshot.step_interval = 1.0;
+    clock_gettime(CLOCK_MONOTONIC, &snapshot.publish_time);
+    snapshot.sub_steps = 0;
+    snapshot.sequence = 0;
+    return snapshot;
+}
+
+void particle_snapshot_copy(ParticleSnapshot *snapshot, ParticleList *list) {
+    particle_list_copy(&snapshot->particle_list, list);
+    snapshot->complete = true;
+    snapshot->has_density = false;
+    snapshot->total_particle_count = list->buffer_len;
+}
+
+// Range of cells (inclusive) that covers [min, max] along one axis of the grid. Particles can have moved
+// by up to about their radius since they were inserted, so one more cell is added on both sides.
+static bool particle_snapshot_cell_range(float min, float max, float half_size, float cell_size, size_t cells, size_t *start, size_t *end) {
+    float first = floorf((min + half_size) / cell_size) - 1.0;
+    float last = floorf((max + half_size) / cell_size) + 1.0;
+    if (last < 0.0 || first > (float)(cells - 1)) {
+        return false;
+    }
+
+    *start = first > 0.0 ? (size_t) first : 0;
+    *end = last < (float)(cells - 1) ? (size_t) last : cells - 1;
+    return true;
+}
+
+void particle_snapshot_copy_visible(
+    ParticleSnapshot *snapshot,
+    ParticleList *list,
+    ParticleGrid *grid,
+    cm2_vec2 view_min, cm2_vec2 view_max
+) {
+    float half_world_width = (grid->width * grid->cell_width) / 2.;
+    float half_world_height = (grid->height * grid->cell_height) / 2.;
+
+    // The y axis of the grid points down
+    size_t start_x, end_x, start_y, end_y;
+    bool visible =
+        particle_snapshot_cell_range(view_min.x, view_max.x, half_world_width, grid->cell_width, grid->width, &start_x, &end_x) &&
+        particle_snapshot_cell_range(-view_max.y, -view_min.y, half_world_height, grid->cell_height, grid->height, &start_y, &end_y);
+
+    // Particles outside of the grid aren't in any cell, so a view that covers the whole grid copies everything
+    size_t visible_cells = visible ? (end_x - start_x + 1) * (end_y - start_y + 1) : 0;
+    if ((float)visible_cells > (float)(grid->width * grid->height) * PARTICLE_SNAPSHOT_MAX_CULLED_CELL_SHARE) {
+        particle_snapshot_copy(snapshot, list);
+        return;
+    }
+
+    // Every particle is in at most one cell, so the whole list is enough room
+    ParticleList *visible_list = &snapshot->particle_list;
+    particle_list_reserve(visible_list, list->buffer_cap);
+    visible_list->buffer_len = 0;
+    visible_list->has_uniform_radius = list->has_uniform_radius;
+    visible_list->uniform_radius = list->uniform_radius;
+    snapshot->complete = false;
+    snapshot->has_density = false;
+    snapshot->total_particle_count = list->buffer_len;
+    if (!visible) {
+        return;
+    }
+
+    size_t len = 0;
+    for (size_t cell_y = start_y; cell_y <= end_y; ++cell_y) {
+        for (size_t cell_x = start_x; cell_x <= end_x; ++cell_x) {
+            if (!particle_grid_is_cell_occupied(grid, cell_x, cell_y)) {
+                continue;
+            }
+
+            ParticleGridCell *cell = particle_grid_cell_at(grid, cell_x, cell_y);
+            for (size_t i = 0; i < cell->indices_len; ++i) {
+                ParticleGridCellIdx idx = cell->indices[i];
+                visible_list->buffer[len] = list->buffer[idx];
+                visible_list->filters[len] = list->filters[idx];
+                visible_list->previous_positions[len] = list->previous_positions[idx];
+                len++;
+            }
+        }
+    }
+    visible_list->buffer_len = len;
+}
+
+static uint8_t particle_snapshot_density_channel(float value) {
+    return value >= 1.0f ? 255 : (uint8_t) (value * 255.0f + 0.5f);
+}
+
+void particle_snapshot_fill_density(ParticleSnapshot *snapshot, ParticleList *list, ParticleGrid *grid) {
+    particle_list_clear(&snapshot->particle_list);
+    snapshot->complete = false;
+    snapshot->has_density = true;
+    snapshot->total_particle_count = list->buffer_len;
+
+    size_t cells = grid->width * grid->height;
+    if (snapshot->density_width != grid->width || snapshot->density_height != grid->height) {
+        snapshot->density_width = grid->width;
+        snapshot->density_height = grid->height;
+        snapshot->density = realloc(snapshot->density, cells * 4);
+        snapshot->density_sums = realloc(snapshot->density_sums, sizeof(float) * cells * 4);
+    }
+    memset(snapshot->density_sums, 0, sizeof(float) * cells * 4);
+
+    // Sum up the area and the color weighted by the area of the particles in each cell, going through the
+    // particles in order (walking the grid cells instead jumps around in the list)
+    float half_world_width = (grid->width * grid->cell_width) / 2.;
+    float half_world_height = (grid->height * grid->cell_height) / 2.;
+    float inv_cell_width = 1.0 / grid->cell_width;
+    float inv_cell_height = 1.0 / grid->cell_height;
+    float *sums = snapshot->density_sums;
+    for (size_t i = 0; i < list->buffer_len; ++i) {
+        Particle *particle = &list->buffer[i];
+        float cell_x = floorf((particle->position.x + half_world_width) * inv_cell_width);
+        float cell_y = floorf((half_world_height - particle->position.y) * inv_cell_height);
+        if (cell_x < 0.0 || cell_y < 0.0 || cell_x >= (float)grid->width || cell_y >= (float)grid->height) {
+            continue;
+        }
+
+        float *sum = &sums[((size_t)cell_y * grid->width + (size_t)cell_x) * 4];
+        float area = (float)M_PI * particle->radius * particle->radius;
+        sum[0] += particle->color.x * area;
+        sum[1] += particle->color.y * area;
+        sum[2] += particle->color.z * area;
+        sum[3] += area;
+    }
+
+    // The color is premultiplied by the density (the share of the cell the particles cover), so it can be
+    // filtered between cells. Overlapping particles can cover more than the cell, the color keeps its hue then.
+    float inv_cell_area = 1.0 / (grid->cell_width * grid->cell_height);
+    for (size_t cell = 0; cell < cells; ++cell) {
+        float *sum = &sums[cell * 4];
+        uint8_t *texel = &snapshot->density[cell * 4];
+        if (sum[3] == 0.0f) {
+            texel[0] = texel[1] = texel[2] = texel[3] = 0;
+            continue;
+        }
+
+        float coverage = sum[3] * inv_cell_area;
+        float scale = coverage < 1.0f ? inv_cell_area : 1.0f / sum[3];
+        texel[0] = particle_snapshot_density_channel(sum[0] * scale);
+        texel[1] = particle_snapshot_density_channel(sum[1] * scale);
+        texel[2] = particle_snapshot_density_channel(sum[2] * scale);
+        texel[3] = particle_snapshot_density_channel(coverage);
+    }
+}
+
+float particle_snapshot_interpolation_alpha(ParticleSnapshot *snapshot) {
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+
+    // The step after the snapshot might not be done yet, so don't extrapolate past it
+    float alpha = (snapshot->step_accumulator + time_diff_ms(snapshot->publish_time, current_time)) / snapshot->step_interval;
+    return alpha < 1.0 ? alpha : 1.0;
+}
+
+void particle_snapshot_delete(ParticleSnapshot *snapshot) {
+    particle_list_delete(&snapshot->particle_list);
+    free(snapshot->density);
+    free(snapshot->density_sums);
+}
+
+SnapshotBuffer snapshot_buffer_new() {
+    SnapshotBuffer snapshot_buffer;
+    for (size_t i = 0; i < 3; ++i) {
+        snapshot_buffer.snapshots[i] = particle_snapshot_new();
+    }
+    snapshot_buffer.write_idx = 0;
+    snapshot_buffer.read_idx = 1;
+    atomic_init(&snapshot_buffer.ready, 2);
+    return snapshot_buffer;
+}
+
+ParticleSnapshot *snapshot_buffer_write_snapshot(SnapshotBuffer *snapshot_buffer) {
+    return &snapshot_buffer->snapshots[snapshot_buffer->write_idx];
+}
+
+void snapshot_buffer_publish(SnapshotBuffer *snapshot_buffer) {
+    // Hand the written snapshot over and continue with the old ready one, which the reader didn't take.
+    // Releasing makes the writes to the snapshot visible to the reader that swaps it in.
+    unsigned int ready = atomic_exchange_explicit(
+        &snapshot_buffer->ready,
+        (unsigned int) snapshot_buffer->write_idx | SNAPSHOT_BUFFER_READY_IS_NEW,
+        memory_order_acq_rel
+    );
+    snapshot_buffer->write_idx = ready & ~SNAPSHOT_BUFFER_READY_IS_NEW;
+}
+
+ParticleSnapshot *snapshot_buffer_read_snapshot(SnapshotBuffer *snapshot_buffer) {
+    // Keep the current snapshot if nothing new was published since the last swap
+    if (atomic_load_explicit(&snapshot_buffer->ready, memory_order_relaxed) & SNAPSHOT_BUFFER_READY_IS_NEW) {
+        unsigned int ready = atomic_exchange_explicit(
+            &snapshot_buffer->ready,
+            (unsigned int) snapshot_buffer->read_idx,
+            memory_order_acq_rel
+        );
+        snapshot_buffer->read_idx = ready & ~SNAPSHOT_BUFFER_READY_IS_NEW;
+    }
+
+    return &snapshot_buffer->snapshots[snapshot_buffer->read_idx];
+}
+
+void snapshot_buffer_delete(SnapshotBuffer *snapshot_buffer) {
+    for (size_t i = 0; i < 3; ++i) {
+        particle_snapshot_delete(&snapshot_buffer->snapshots[i]);
+    }
+}
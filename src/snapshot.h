@@ -0,0 +1,92 @@
+#ifndef PARTICLE_SNAPSHOT_H
+#define PARTICLE_SNAPSHOT_H
+
+#include "particle/grid/grid.h"
+#include "particle/list.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Culling gathers the particles cell by cell, which is several times slower per particle than copying the
+// whole list. If more than this share of the grid cells is visible, the whole list is copied instead.
+#ifndef PARTICLE_SNAPSHOT_MAX_CULLED_CELL_SHARE
+#define PARTICLE_SNAPSHOT_MAX_CULLED_CELL_SHARE 0.25
+#endif /* PARTICLE_SNAPSHOT_MAX_CULLED_CELL_SHARE */
+
+// State of the particles after a simulation step, copied out of the updater so that it can be rendered
+// while the next steps run
+typedef struct {
+    // Current and previous positions of every visible particle, so rendering can interpolate between them.
+    // If the snapshot is complete, this is a copy of the whole list (in the same order), otherwise it only
+    // contains the particles around the view, in the order of their grid cells.
+    ParticleList particle_list;
+    bool complete;
+    size_t total_particle_count;
+
+    // Set instead of the particles when the view is zoomed out far enough: average color of the particles in
+    // each grid cell premultiplied by their density (RGB), and the density (A), as RGBA8, row by row from the
+    // top left cell
+    bool has_density;
+    uint8_t *density;
+    size_t density_width, density_height;
+
+    // Sums of the color and area of the particles in each cell, from which the density is computed
+    float *density_sums;
+
+    // Time that had passed since the step (in milliseconds) when the snapshot was published, and the
+    // length of a step. Together with the time since `publish_time`, this gives the interpolation alpha.
+    float step_accumulator;
+    float step_interval;
+    struct timespec publish_time;
+
+    size_t sub_steps;
+
+    // Number of snapshots that were published before this one
+    size_t sequence;
+} ParticleSnapshot;
+
+ParticleSnapshot particle_snapshot_new();
+void particle_snapshot_copy(ParticleSnapshot *snapshot, ParticleList *list);
+// Only copies the particles in the cells of `grid` that overlap the rectangle from `view_min` to `view_max`,
+// or all particles if the rectangle covers too much of the grid. The particles have to be inserted into the grid.
+void particle_snapshot_copy_visible(
+    ParticleSnapshot *snapshot,
+    ParticleList *list,
+    ParticleGrid *grid,
+    cm2_vec2 view_min, cm2_vec2 view_max
+);
+// Fills the density of every grid cell instead of copying particles. Only the size of the grid is used, the
+// particles don't have to be inserted into it.
+void particle_snapshot_fill_density(ParticleSnapshot *snapshot, ParticleList *list, ParticleGrid *grid);
+// Fraction of a step that has passed since the snapshot's step, at most 1
+float particle_snapshot_interpolation_alpha(ParticleSnapshot *snapshot);
+void particle_snapshot_delete(ParticleSnapshot *snapshot);
+
+// Triple buffer of snapshots, shared by one writer (the simulation) and one reader (the renderer).
+// The writer fills its own snapshot and then swaps it with the ready one, the reader swaps its own snapshot
+// with the ready one if that is newer. Both swaps are a single atomic exchange of an index, so neither
+// side ever waits for the other one to finish copying or drawing, and the reader always gets the newest
+// complete snapshot.
+typedef struct {
+    ParticleSnapshot snapshots[3];
+    size_t write_idx;
+    size_t read_idx;
+
+    // Index of the ready snapshot, with `SNAPSHOT_BUFFER_READY_IS_NEW` set if it was published after the
+    // reader's last swap
+    atomic_uint ready;
+} SnapshotBuffer;
+
+#define SNAPSHOT_BUFFER_READY_IS_NEW 4u
+
+SnapshotBuffer snapshot_buffer_new();
+// Snapshot that the writer fills before publishing it
+ParticleSnapshot *snapshot_buffer_write_snapshot(SnapshotBuffer *snapshot_buffer);
+void snapshot_buffer_publish(SnapshotBuffer *snapshot_buffer);
+// Newest published snapshot, which stays valid until the next call
+ParticleSnapshot *snapshot_buffer_read_snapshot(SnapshotBuffer *snapshot_buffer);
+void snapshot_buffer_delete(SnapshotBuffer *snapshot_buffer);
+
+#endif /* PARTICLE_SNAPSHOT_H */
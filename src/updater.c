@@ -10,10 +10,11 @@ ParticleEmitter particle_emitter_new(size_t particle_count, cm2_vec2 spawn_posit
     emitter.spawn_position = spawn_position;
     emitter.spawn_velocity = spawn_velocity;
     emitter.spawn_radius = spawn_radius;
+    emitter.spawn_collision_filter = particle_collision_filter_default();
     return emitter;
 }
 
-void particle_emitter_spawn_random_colored(ParticleEmitter *emitter, ParticleList *list) {
+void particle_emitter_spawn_random_colored(ParticleEmitter *emitter, ParticleList *list, float velocity_scale) {
     // Create randomly colored particle
     Particle particle = particle_new(
         emitter->spawn_position.x, emitter->spawn_position.y,
@@ -22,10 +23,10 @@ void particle_emitter_spawn_random_colored(ParticleEmitter *emitter, ParticleLis
     );
 
     // Add velocity to particle
-    particle.position = cm2_vec2_add(particle.position, emitter->spawn_velocity);
+    particle.position = cm2_vec2_add(particle.position, cm2_vec2_scale(emitter->spawn_velocity, velocity_scale));
 
     // Push the particle to the list
-    particle_list_push(list, particle);
+    particle_list_push_with_filter(list, particle, emitter->spawn_collision_filter);
 }
 
 ParticleUpdater particle_updater_new(size_t emitter_count) {
@@ -36,8 +37,21 @@ ParticleUpdater particle_updater_new(size_t emitter_count) {
     updater.emitters =
         (ParticleEmitter*) malloc(sizeof(ParticleEmitter) * emitter_count);
 
-    // Initialize timer
-    clock_gettime(CLOCK_REALTIME, &updater.particle_spawn_timer);
+    // Static particles, obstacles, force fields and links are optional and created by the caller.
+    // Until then they're zeroed, so deleting the updater is safe even if some are never created.
+    updater.static_particles = (StaticParticles) {0};
+    updater.obstacles = (Obstacles) {0};
+    updater.force_fields = (ForceFields) {0};
+    updater.links = (ParticleLinks) {0};
+
+    // Initialize timers
+    updater.particle_spawn_timer = 0.0;
+
+    updater.step_interval = PARTICLE_UPDATER_DEFAULT_STEP_INTERVAL;
+    updater.max_steps_per_advance = PARTICLE_UPDATER_DEFAULT_MAX_STEPS_PER_ADVANCE;
+    updater.step_accumulator = 0.0;
+    updater.last_advance_steps = 0;
+    clock_gettime(CLOCK_MONOTONIC, &updater.last_advance_time);
 
     return updater;
 }
@@ -45,34 +59,73 @@ ParticleUpdater particle_updater_new(size_t emitter_count) {
 void particle_updater_update(ParticleUpdater *updater) {
     ParticleList *particle_list = &updater->particle_list;
 
-    // Measure elapsed milliseconds since last particle spawn iteration
-    struct timespec current_timer;
-    clock_gettime(CLOCK_REALTIME, &current_timer);
-    float elapsed_millis = time_diff_ms(updater->particle_spawn_timer, current_timer);
+    // Remember where the particles were before this step, so rendering can interpolate
+    particle_list_store_previous_positions(particle_list);
+
+    // The spawn timer advances by the step interval, so spawning is tied to simulation steps
+    // and not to the (possibly jumping) wall clock
+    updater->particle_spawn_timer += updater->step_interval;
 
-    // Spawn particles for each emitter if enough time has passed
-    if (elapsed_millis > updater->particle_spawn_time_interval) {
+    // Spawn particles for each emitter once per spawn interval that has passed. The remaining time is kept,
+    // so intervals that aren't a multiple of the step interval still spawn at the right rate on average.
+    while (updater->particle_spawn_time_interval > 0.0
+           && updater->particle_spawn_timer >= updater->particle_spawn_time_interval) {
         for (size_t i = 0; i < updater->emitter_count; ++i) {
             ParticleEmitter *emitter = &updater->emitters[i];
 
             // If there are particles left to spawn, do so
             if (emitter->particles_left_to_spawn > 0) {
-                particle_emitter_spawn_random_colored(emitter, particle_list);
+                particle_emitter_spawn_random_colored(emitter, particle_list, solver_velocity_scale(&updater->solver));
                 emitter->particles_left_to_spawn--;
             }
         }
 
-        updater->particle_spawn_timer = current_timer;
+        updater->particle_spawn_timer -= updater->particle_spawn_time_interval;
     }
 
-    // Update the solver
+    // Update the solver, picking the number of sub steps first if that's enabled
+    solver_adapt_sub_steps(&updater->solver, particle_list);
     solver_update(&updater->solver);
 }
 
+size_t particle_updater_advance(ParticleUpdater *updater) {
+    // Measure real time since the last call with a monotonic clock
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    updater->step_accumulator += time_diff_ms(updater->last_advance_time, current_time);
+    updater->last_advance_time = current_time;
+
+    // Run as many fixed steps as real time requires
+    size_t steps = 0;
+    while (updater->step_accumulator >= updater->step_interval && steps < updater->max_steps_per_advance) {
+        particle_updater_update(updater);
+        updater->step_accumulator -= updater->step_interval;
+        steps++;
+    }
+
+    // If the simulation couldn't keep up, drop the time that is left over. Otherwise, every following
+    // call would try to catch up by running even more steps, taking even longer (spiral of death).
+    if (updater->step_accumulator >= updater->step_interval) {
+        updater->step_accumulator = 0.0;
+    }
+
+    updater->last_advance_steps = steps;
+    return steps;
+}
+
+float particle_updater_interpolation_alpha(ParticleUpdater *updater) {
+    // Fraction of a step that has passed since the last step
+    return updater->step_accumulator / updater->step_interval;
+}
+
 void particle_updater_delete(ParticleUpdater *updater) {
     free(updater->emitters);
 
     particle_grid_delete(&updater->particle_grid);
+    static_particles_delete(&updater->static_particles);
+    obstacles_delete(&updater->obstacles);
+    force_fields_delete(&updater->force_fields);
+    particle_links_delete(&updater->links);
     particle_list_delete(&updater->particle_list);
     solver_delete(&updater->solver);
 }
@@ -3,34 +3,65 @@
 
 #include "particle/list.h"
 #include "particle/grid/grid.h"
+#include "particle/static_particles.h"
+#include "particle/obstacles/obstacles.h"
+#include "particle/force_field.h"
+#include "particle/links.h"
 #include "particle/solver/solver.h"
 
 #include <time.h>
 #include <pthread.h>
 
+// Real time (in milliseconds) that one fixed simulation step represents
+#ifndef PARTICLE_UPDATER_DEFAULT_STEP_INTERVAL
+#define PARTICLE_UPDATER_DEFAULT_STEP_INTERVAL (1000.0 / 60.0)
+#endif /* PARTICLE_UPDATER_DEFAULT_STEP_INTERVAL */
+
+// Maximum number of steps that are run to catch up with real time in one call to `particle_updater_advance`
+#ifndef PARTICLE_UPDATER_DEFAULT_MAX_STEPS_PER_ADVANCE
+#define PARTICLE_UPDATER_DEFAULT_MAX_STEPS_PER_ADVANCE 4
+#endif /* PARTICLE_UPDATER_DEFAULT_MAX_STEPS_PER_ADVANCE */
+
 typedef struct {
     cm2_vec2 spawn_position;
     cm2_vec2 spawn_velocity;
     float spawn_radius;
+    ParticleCollisionFilter spawn_collision_filter;
     size_t particles_left_to_spawn;
 } ParticleEmitter;
 
 ParticleEmitter particle_emitter_new(size_t particle_count, cm2_vec2 spawn_position, cm2_vec2 spawn_velocity, float spawn_radius);
-void particle_emitter_spawn_random_colored(ParticleEmitter *emitter, ParticleList *list);
+void particle_emitter_spawn_random_colored(ParticleEmitter *emitter, ParticleList *list, float velocity_scale);
 
 typedef struct {
     ParticleList particle_list;
     ParticleGrid particle_grid;
+    StaticParticles static_particles;
+    Obstacles obstacles;
+    ForceFields force_fields;
+    ParticleLinks links;
     Solver solver;
 
+    // Simulated time (in milliseconds) between two spawns of every emitter. The spawn timer advances by
+    // `step_interval` per step, so an interval of `step_interval` spawns one particle per emitter and step,
+    // and shorter intervals spawn several particles per step.
     float particle_spawn_time_interval;
-    struct timespec particle_spawn_timer;
+    float particle_spawn_timer;
     ParticleEmitter *emitters;
     size_t emitter_count;
+
+    // Fixed timestep: every `step_interval` milliseconds of real time, one simulation step is run
+    float step_interval;
+    size_t max_steps_per_advance;
+    float step_accumulator;
+    struct timespec last_advance_time;
+    size_t last_advance_steps;
 } ParticleUpdater;
 
 ParticleUpdater particle_updater_new(size_t emitter_count);
 void particle_updater_update(ParticleUpdater *updater);
+size_t particle_updater_advance(ParticleUpdater *updater);
+float particle_updater_interpolation_alpha(ParticleUpdater *updater);
 void particle_updater_delete(ParticleUpdater *updater);
 
 #endif /* PARTICLE_UPDATER_H */
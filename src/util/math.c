@@ -1,6 +1,7 @@
 #include "math.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 float randf() {
     return (float)rand() / RAND_MAX;
@@ -9,3 +10,43 @@ float randf() {
 float time_diff_ms(struct timespec t0, struct timespec t1) {
     return (t1.tv_sec - t0.tv_sec) * 1000.0f + (t1.tv_nsec - t0.tv_nsec) / 1000000.0f;
 }
+
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x007FFFFF;
+
+    // NaN and infinity
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return sign | 0x7C00 | (mantissa ? 0x0200 : 0);
+    }
+
+    // Too large: infinity
+    if (exponent >= 31) {
+        return sign | 0x7C00;
+    }
+
+    // Too small for a normal half: subnormal or zero
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return sign;
+        }
+
+        mantissa |= 0x00800000;
+        uint32_t shift = (uint32_t)(14 - exponent);
+        uint32_t half_mantissa = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        half_mantissa += (rest > halfway) | ((rest == halfway) & half_mantissa);
+        return sign | (uint16_t)half_mantissa;
+    }
+
+    // Normal half, rounding may carry into the exponent (up to infinity), which is still correct
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    half += (rest > 0x1000) | ((rest == 0x1000) & half);
+    return sign | (uint16_t)half;
+}
@@ -1,10 +1,14 @@
 #ifndef UTIL_MATH_H
 #define UTIL_MATH_H
 
+#include <stdint.h>
 #include <time.h>
 
 float randf();
 
+// Converts to a half precision float (IEEE 754 binary16), rounding to nearest even
+uint16_t float_to_half(float value);
+
 float time_diff_ms(struct timespec t0, struct timespec t1);
 
 #endif /* UTIL_MATH_H */